@@ -4,10 +4,60 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
+#include <signal.h>
+#include <limits.h>
+#include <stdarg.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#define fileno _fileno
+#define read _read
+#else
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+/* The loop JIT emits x86-64 machine code and maps it with mmap */
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#define JIT_SUPPORTED 1
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+/* The pipelined mode runs the lexer on a POSIX thread; server mode needs Unix sockets and fork;
+   the scheduler switches between scripts with ucontext and waits for their input with poll;
+   --check forks worker processes that share a counter of the next file */
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#define PIPELINE_SUPPORTED 1
+#define SERVER_SUPPORTED 1
+#define SCHEDULER_SUPPORTED 1
+#define PARALLEL_CHECK_SUPPORTED 1
+#else
+#define PIPELINE_SUPPORTED 0
+#define SERVER_SUPPORTED 0
+#define SCHEDULER_SUPPORTED 0
+#define PARALLEL_CHECK_SUPPORTED 0
+#endif
 
 #define MAX_VAR_COUNT 100
 #define MAX_STR_LEN 256
 #define MAX_INT 99999999
+#define MAX_LOOP_DEPTH 64       // Deepest loop nesting accepted; bounds every pass that recurses into bodies
 
 /* Define maximum sizes */
 #define MAX_IDENTIFIER_SIZE 10
@@ -31,11 +81,251 @@ typedef enum {
 typedef struct {
     TokenType type;             // Token type
     char value[MAX_STRING_SIZE];/* Token value */
+    int line;                   // Source line of the first character
+    int column;                 // Source column of the first character
 } Token;
 
 /* Function prototypes */
 Token getNextToken(FILE *fp);
-void printToken(Token token);
+void printToken(FILE *outputFile, Token token);
+
+/* Memory accounting: every heap block is tagged with the subsystem that owns it */
+typedef enum {
+    MEM_LEXER,                  // Token structures
+    MEM_PROGRAM,                // Statement text, loop bodies, source maps, compiled code
+    MEM_VARIABLES,              // Variable table slots
+    MEM_TEXT,                   // Text values and string results
+    MEM_TEMP,                   // Expression and statement copies
+    MEM_CATEGORIES
+} MemCategory;
+
+typedef struct {
+    long long current;          // Bytes in use
+    long long peak;             // Highest value of current
+    long long allocations;      // Number of allocations
+} MemCounter;
+
+const char* memCategoryNames[MEM_CATEGORIES] = { "lexer", "program", "variables", "text", "temporaries" };
+MemCounter memCounters[MEM_CATEGORIES];
+MemCounter memTotal;
+
+int statsEnabled = 0;           // --stats: print the counters after the run
+long long tokenCount = 0;       // Tokens produced by the lexer
+long long statementCount = 0;   // Statements executed
+
+/* Size and owner stored in front of each block */
+typedef union {
+    struct {
+        size_t size;
+        int category;
+    } info;
+    long double align;          // Keeps the user data maximally aligned
+} MemHeader;
+
+/* Records bytes taken (positive) or given back (negative) by a subsystem */
+void memAccount(MemCategory category, long long bytes) {
+    MemCounter* counter = &memCounters[category];
+    counter->current += bytes;
+    if (counter->current > counter->peak) counter->peak = counter->current;
+    memTotal.current += bytes;
+    if (memTotal.current > memTotal.peak) memTotal.peak = memTotal.current;
+}
+
+/* Memory outside the heap (token values, table slots) taken by a subsystem */
+void memNote(MemCategory category, long long bytes) {
+    memAccount(category, bytes);
+    memCounters[category].allocations++;
+    memTotal.allocations++;
+}
+
+void* memAlloc(MemCategory category, size_t size) {
+    MemHeader* header = (MemHeader*)malloc(sizeof(MemHeader) + size);
+    if (header == NULL) {
+        printf("Error: Out of memory.\n");
+        exit(1);
+    }
+    header->info.size = size;
+    header->info.category = category;
+    memNote(category, size);
+    return header + 1;
+}
+
+void* memCalloc(MemCategory category, size_t count, size_t size) {
+    void* block = memAlloc(category, count * size);
+    memset(block, 0, count * size);
+    return block;
+}
+
+/* Grows or shrinks a block; a NULL block is allocated for the given category */
+void* memRealloc(MemCategory category, void* block, size_t size) {
+    if (block == NULL) return memAlloc(category, size);
+
+    MemHeader* header = (MemHeader*)realloc((MemHeader*)block - 1, sizeof(MemHeader) + size);
+    if (header == NULL) {
+        printf("Error: Out of memory.\n");
+        exit(1);
+    }
+    memAccount(header->info.category, (long long)size - (long long)header->info.size);
+    header->info.size = size;
+    return header + 1;
+}
+
+void memFree(void* block) {
+    if (block == NULL) return;
+    MemHeader* header = (MemHeader*)block - 1;
+    memAccount(header->info.category, -(long long)header->info.size);
+    free(header);
+}
+
+char* memStrdup(MemCategory category, const char* str) {
+    size_t size = strlen(str) + 1;
+    char* copy = (char*)memAlloc(category, size);
+    memcpy(copy, str, size);
+    return copy;
+}
+
+void printStats(void) {
+    fprintf(stderr, "\nMemory (bytes):\n");
+    fprintf(stderr, "%-12s %12s %12s %12s\n", "subsystem", "current", "peak", "allocations");
+    for (int i = 0; i < MEM_CATEGORIES; i++) {
+        fprintf(stderr, "%-12s %12lld %12lld %12lld\n", memCategoryNames[i],
+                memCounters[i].current, memCounters[i].peak, memCounters[i].allocations);
+    }
+    fprintf(stderr, "%-12s %12lld %12lld %12lld\n", "total", memTotal.current, memTotal.peak, memTotal.allocations);
+    fprintf(stderr, "Tokens: %lld\n", tokenCount);
+    fprintf(stderr, "Statements executed: %lld\n", statementCount);
+}
+
+/* Run limits: --max-statements, --max-text and --max-time stop a runaway script with an exit
+   status of its own. Statements and the clock are checked before top-level statements and at
+   loop back-edges, the clock only every LIMIT_CLOCK_EVERY back-edges; text bytes are checked
+   where a TEXT value grows. */
+#define EXIT_STATEMENT_LIMIT 3
+#define EXIT_TEXT_LIMIT 4
+#define EXIT_TIME_LIMIT 5
+#define LIMIT_CLOCK_EVERY 4096
+
+long long profileNow(void);
+
+int limitsEnabled = 0;                  // Any of the limits was given
+long long statementLimit = LLONG_MAX;   // Statements executed
+long long textLimit = LLONG_MAX;        // Bytes held by TEXT values
+long long textBytes = 0;                // Capacity of the TEXT variables of the program, checked against textLimit
+long long timeLimit = 0;                // Wall time in nanoseconds, 0 for none
+long long limitDeadline = 0;
+int limitClockCountdown = LIMIT_CLOCK_EVERY;
+
+void startLimits(void) {
+    limitDeadline = timeLimit > 0 ? profileNow() + timeLimit : 0;
+    limitClockCountdown = LIMIT_CLOCK_EVERY;
+}
+
+struct Script;
+struct Script* currentScript = NULL;    // Script run by the scheduler, NULL outside of it
+void finishScript(int status);
+
+/* Ends the run; a scheduled script ends alone and the other scripts go on */
+void endRun(int status) {
+#if SCHEDULER_SUPPORTED
+    if (currentScript != NULL) finishScript(status);
+#endif
+    exit(status);
+}
+
+void stopRun(int status, const char* message) {
+    fflush(stdout);
+    printf("Error: %s.\n", message);
+    if (statsEnabled && currentScript == NULL) printStats();    // The harness prints them once at the end
+    endRun(status);
+}
+
+void checkLimits(void) {
+    limitClockCountdown = LIMIT_CLOCK_EVERY;
+    if (statementCount > statementLimit) stopRun(EXIT_STATEMENT_LIMIT, "Statement limit exceeded");
+    if (limitDeadline != 0 && profileNow() >= limitDeadline) stopRun(EXIT_TIME_LIMIT, "Time limit exceeded");
+}
+
+/* Loop back-edge: one comparison and one decrement while no limit is near */
+#define LIMIT_BACK_EDGE() \
+    if (limitsEnabled && (statementCount > statementLimit || --limitClockCountdown == 0)) checkLimits()
+
+/* Source position of the lexer */
+int lexLine = 1;                // Line of the next character
+int lexColumn = 1;              // Column of the next character
+int lexPrevColumn = 1;          // Column before the last character, restored by unreadChar
+
+/* --check: problems are collected with their source position instead of ending the run */
+typedef struct {
+    int line;
+    int column;
+    char* message;
+} Diagnostic;
+
+typedef struct {
+    Diagnostic* items;
+    int count;
+    int capacity;
+} DiagnosticList;
+
+DiagnosticList* diagnostics = NULL;     // Set while a file is being checked
+
+void addDiagnostic(int line, int column, const char* format, ...) {
+    char message[MAX_STRING_SIZE + 64];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    // Records are tab separated lines
+    for (char* p = message; *p; p++) {
+        if (*p == '\t' || *p == '\n' || *p == '\r') *p = ' ';
+    }
+
+    DiagnosticList* list = diagnostics;
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 16;
+        list->items = (Diagnostic*)memRealloc(MEM_TEMP, list->items, list->capacity * sizeof(Diagnostic));
+    }
+    list->items[list->count].line = line;
+    list->items[list->count].column = column;
+    list->items[list->count].message = memStrdup(MEM_TEMP, message);
+    list->count++;
+}
+
+/* A lexer error ends the run; while checking it is recorded and lexing goes on after the bad input */
+void lexError(int line, int column, const char* format, ...) {
+    char message[64];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    if (diagnostics != NULL) {
+        addDiagnostic(line, column, "%s", message);
+        return;
+    }
+    printf("Error: %s at line %d, column %d.\n", message, line, column);   // Error message
+    exit(-1);                       // Terminate the program
+}
+
+int readChar(FILE *fp)
+{
+    int c = fgetc(fp);                      // Get the character from the file
+    lexPrevColumn = lexColumn;              // Remember the column for a push back
+    if (c == '\n') {                        // A new line starts
+        lexLine++;
+        lexColumn = 1;
+    } else if (c != EOF) {
+        lexColumn++;
+    }
+    return c;
+}
+
+void unreadChar(FILE *fp, int c)
+{
+    if (c == EOF) return;                   // Nothing to push back at the end of the file
+    ungetc(c, fp);                          // Push the character back
+    if (c == '\n') lexLine--;               // Step back over the new line
+    lexColumn = lexPrevColumn;              // Restore the column
+}
 
 /* Main function */
 
@@ -47,34 +337,40 @@ Token getNextToken(FILE *fp)
     int i = 0;                              // Buffer index
     char c;                                 // Character storage variable
 
+next:
     /* Skip whitespace and comments */
     do {
-        c = fgetc(fp);                      // Get the character from the file
+        c = readChar(fp);                   // Get the character from the file
         if (c == '/') {                     // If the character is a "/"
-            char nextChar = fgetc(fp);      // Get the next character
+            char nextChar = readChar(fp);   // Get the next character
             if (nextChar == '*') {          // If the next character is ""
+                token.line = lexLine;       // Comment start, for the error message
+                token.column = lexPrevColumn - 1;
                 int commentDepth = 1;       // Depth counter to track comment nesting
                 while (commentDepth > 0) {  // Loop until the end of the comment
                     char prevChar = c;     // Store the previous character
-                    c = fgetc(fp);         // Get the next character
+                    c = readChar(fp);      // Get the next character
                     if (prevChar == '*' && c == '/')   // End of comment check
                         commentDepth--;     // Found the end of a comment, decrement depth counter
                     else if (prevChar == '/' && c == '*') // Nested comment check
                         commentDepth++;     // Found the start of a nested comment, increment depth counter
                     else if (c == EOF) {   // End of file check
-                        printf("Error: Unclosed comment.\n");   // Error message
-                        exit(-1);           // Terminate the program
+                        lexError(token.line, token.column, "Unclosed comment");
+                        break;              // Checking: the comment ends with the file
                     }
                 }
-                c = fgetc(fp);              // Get the character after the comment
+                c = readChar(fp);           // Get the character after the comment
             }
             else {
-                fseek(fp, -1, SEEK_CUR);   // If not a comment, move the file pointer back
+                unreadChar(fp, nextChar);  // If not a comment, move the file pointer back
                 break; // Exit the loop     
             }
         }
     } while (isspace(c));                  // Skip whitespace characters
 
+    token.line = lexLine;                  // Position of the first character
+    token.column = lexPrevColumn;
+
     /* End of file check */
     
     /* End of line marker */
@@ -89,17 +385,17 @@ Token getNextToken(FILE *fp)
     if (isalpha(c))
     {
         buffer[i++] = c;                    // Add character to buffer
-        while ((isalnum(c = fgetc(fp)) || c == '_') && i < MAX_IDENTIFIER_SIZE)
+        while ((isalnum(c = readChar(fp)) || c == '_') && i < MAX_IDENTIFIER_SIZE)
         {
             buffer[i++] = c;                // Add character to buffer
         }
         
         if (i == MAX_IDENTIFIER_SIZE && (isalnum(c) || c == '_')) {
-            printf("Error: Identifier too long.\n");   // Error message
-            exit(-1);                       // Terminate the program
+            lexError(token.line, token.column, "Identifier too long");
+            while (isalnum(c) || c == '_') c = readChar(fp);    // Checking: skip the rest of it
         }
         buffer[i] = '\0';                   // Add null character at the end of the buffer
-        fseek(fp, -1, SEEK_CUR);            // Move the file pointer back
+        unreadChar(fp, c);                  // Move the file pointer back
 
         /* Check for defined keywords */
         if (strcmp(buffer, "int") == 0 || strcmp(buffer, "text") == 0 ||
@@ -122,16 +418,16 @@ Token getNextToken(FILE *fp)
     if (isdigit(c))
     {
         buffer[i++] = c;                    // Add character to buffer
-        while (isdigit(c = fgetc(fp)) && i < MAX_INT_SIZE)
+        while (isdigit(c = readChar(fp)) && i < MAX_INT_SIZE)
         {
             buffer[i++] = c;                // Add character to buffer
         }
         if (i == MAX_INT_SIZE && isdigit(c)) {
-            printf("Error: Integer constant too long.\n");    // Error message
-            exit(-1);                       // Terminate the program
+            lexError(token.line, token.column, "Integer constant too long");
+            while (isdigit(c)) c = readChar(fp);                // Checking: skip the rest of it
         }
         buffer[i] = '\0';                   // Add null character at the end of the buffer
-        fseek(fp, -1, SEEK_CUR);            // Move the file pointer back
+        unreadChar(fp, c);                  // Move the file pointer back
         token.type = INT_CONST;             // Set token type
         strcpy(token.value, buffer);        // Copy token value
         return token;                       // Return the token
@@ -166,16 +462,20 @@ Token getNextToken(FILE *fp)
     if (c == '"')
     {
         buffer[i++] = c;                    // Add character to buffer
-        while ((c = fgetc(fp)) != '"' && c != EOF && i < MAX_STRING_SIZE)
+        while ((c = readChar(fp)) != '"' && c != EOF && i < MAX_STRING_SIZE - 2)
         {
-            buffer[i++] = c;                // Add character to buffer
+            buffer[i++] = c;                // Add character to buffer (room is left for the quote and '\0')
+        }
+        if (c != '"' && c != EOF)
+        {
+            lexError(token.line, token.column, "String constant too long");
+            while (c != '"' && c != EOF) c = readChar(fp);      // Checking: skip to the closing quote
         }
         if (c != '"')
         {
-            printf("Error: String constant not terminated.\n");    // Error message
-            exit(-1);                       // Terminate the program
+            lexError(token.line, token.column, "String constant not terminated");
         }
-        buffer[i++] = c;                    // Add character to buffer
+        buffer[i++] = '"';                  // Add the closing quote to buffer
         buffer[i] = '\0';                   // Add null character at the end of the buffer
         token.type = STRING_CONST;          // Set token type
         strcpy(token.value, buffer);        // Copy token value
@@ -198,137 +498,255 @@ Token getNextToken(FILE *fp)
     }
 
     /* Invalid character */
-    printf("Error: Invalid character: %c\n", c);   // Error message
-    exit(-1);                       // Terminate the program
+    lexError(token.line, token.column, "Invalid character: %c", c);
+    goto next;                      // Checking: go on with the next token
 }
 
-void printToken(Token token)
+int formatToken(const Token* token, char* out, size_t size)
 {
-    /* Function to write the token to the output file */
-
-    FILE *outputFile = fopen("code.lex", "a");  // Open the output file
-    if (outputFile == NULL)
-    {
-        printf("Error writing to output file.\n");  // Error message
-        exit(-1);                                    // Terminate the program
-    }
+    /* Function to write the token text, e.g. Identifier(x), into out; returns its length */
 
-    switch (token.type)  // Switch case based on token type
+    switch (token->type)  // Switch case based on token type
     {
     case IDENTIFIER:  // Identifier
-        fprintf(outputFile, "Identifier(%s)\n", token.value);  // Write the identifier
-        break;
+        return snprintf(out, size, "Identifier(%s)", token->value);  // Write the identifier
     case INT_CONST:  // Integer constant
-        fprintf(outputFile, "IntConst(%s)\n", token.value);  // Write the integer constant
-        break;
+        return snprintf(out, size, "IntConst(%s)", token->value);  // Write the integer constant
     case OPERATOR:  // Operator
-        fprintf(outputFile, "Operator(%s)\n", token.value);  // Write the operator
-        break;
+        return snprintf(out, size, "Operator(%s)", token->value);  // Write the operator
     case LEFT_CURLY_BRACKET:  // Left curly bracket
-        fprintf(outputFile, "LeftCurlyBracket\n");  // Write the left curly bracket
-        break;
+        return snprintf(out, size, "LeftCurlyBracket");  // Write the left curly bracket
     case RIGHT_CURLY_BRACKET:  // Right curly bracket
-        fprintf(outputFile, "RightCurlyBracket\n");  // Write the right curly bracket
-        break;
+        return snprintf(out, size, "RightCurlyBracket");  // Write the right curly bracket
     case STRING_CONST:  // String constant
-        fprintf(outputFile, "String(%s)\n", token.value);  // Write the string constant
-        break;
+        return snprintf(out, size, "String(%s)", token->value);  // Write the string constant
     case END_OF_LINE:  // End of line marker
-        fprintf(outputFile, "EndOfLine\n");  // Write the end of line marker
-        break;
+        return snprintf(out, size, "EndOfLine");  // Write the end of line marker
     case COMMA:  // Comma
-        fprintf(outputFile, "Comma\n");  // Write the comma
-        break;
+        return snprintf(out, size, "Comma");  // Write the comma
     case KEYWORD:  // Keyword
-        fprintf(outputFile, "Keyword(%s)\n", token.value);  // Write the keyword
-        break;
+        return snprintf(out, size, "Keyword(%s)", token->value);  // Write the keyword
     default:
-        fprintf(outputFile, "Error: Unknown token type\n");  // Unknown token type error
-        break;
+        return snprintf(out, size, "Error: Unknown token type");  // Unknown token type error
+    }
+}
+
+void printToken(FILE *outputFile, Token token)
+{
+    /* Function to write the token to the output file */
+
+    char text[MAX_STRING_SIZE + 32];  // Token text
+    formatToken(&token, text, sizeof(text));
+    fprintf(outputFile, "%s\t%d:%d\n", text, token.line, token.column);  // Write the token and its source position
+}
+
+/* Lexes the whole input; a run of end of line markers is passed on once, at its first position */
+void lexTokens(FILE *inputFile, void (*emit)(const Token* token, void* context), void* context)
+{
+    Token token;
+    int endOfLineCount = 0;   // End of line counter
+    do {
+        token = getNextToken(inputFile);   // Get the next token
+        if (token.type != END_OF_LINE) {   // If the token is not an end of line
+            emit(&token, context);         // Pass the token on
+            endOfLineCount = 0;            // Reset the end of line counter
+        } else if (endOfLineCount++ == 0) {
+            emit(&token, context);         // Only the first end of line of a run
+        }
+    } while (!feof(inputFile));            // Continue until the end of the file
+}
+
+/* Sequential mode: tokens go to code.lex, which Interpreter() reads back */
+void emitToFile(const Token* token, void* context)
+{
+    memNote(MEM_LEXER, sizeof(Token));     // Account the token value
+    printToken((FILE*)context, *token);    // Write the token
+    memAccount(MEM_LEXER, -(long long)sizeof(Token));  // The token is a reused temporary
+    tokenCount++;                          // Count the token
+}
+
+
+/* Growable text: appends are amortized O(1), so assembling a statement is linear in its size */
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} TextBuffer;
+
+void bufferReserve(TextBuffer* buffer, size_t length) {
+    if (length + 1 > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : 256;
+        while (capacity < length + 1) capacity *= 2;
+        buffer->data = (char*)memRealloc(MEM_PROGRAM, buffer->data, capacity);
+        buffer->capacity = capacity;
     }
-    
-    fclose(outputFile);  // Close the output file
 }
 
+void bufferAppend(TextBuffer* buffer, const char* text, size_t length) {
+    bufferReserve(buffer, buffer->length + length);
+    memcpy(buffer->data + buffer->length, text, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = '\0';
+}
+
+void bufferClear(TextBuffer* buffer) {
+    buffer->length = 0;
+    if (buffer->data != NULL) buffer->data[0] = '\0';
+}
 
 typedef enum { INT, TEXT } VarType;
 
+/* Variable store: values live in dense arrays split by type, so a loop over INT variables
+   only touches their 4-byte slots. Names are kept to the side and are read only while
+   statements are resolved; a Variable is the typed index the rest of the code holds. */
 typedef struct {
-    char name[32];
     VarType type;
-    union {
-        int intValue;
-        char strValue[MAX_STR_LEN];
-    };
+    int slot;                           // Index into ints or texts
 } Variable;
 
-Variable variables[MAX_VAR_COUNT];
-int varCount = 0;
+typedef struct {
+    Variable vars[MAX_VAR_COUNT];       // In declaration order
+    char names[MAX_VAR_COUNT][32];      // Name of vars[i]
+    int count;
+    int ints[MAX_VAR_COUNT];
+    int intCount;
+    TextBuffer texts[MAX_VAR_COUNT];    // Grown geometrically so appends are amortized O(1)
+    int textCount;
+} VariableStore;
+
+VariableStore variables;
+
+int quietMode = 0;      // -q: suppress the Declared/Assigned/Loop iteration trace lines
+int jitEnabled = 0;     // --jit: compile hot loop bodies to native code
+int profileEnabled = 0; // --profile: per statement counts and times
+int pipelineEnabled = 0;    // --pipeline: run statements while the lexer thread is still reading
+
+/* --prompt: when read prints its prompt */
+typedef enum { PROMPT_ALWAYS, PROMPT_AUTO, PROMPT_NEVER } PromptMode;
+PromptMode promptMode = PROMPT_ALWAYS;
 
 void execute(const char* line);
+struct SourceMap;
+void handleLoop(int loopCount, const char* loopBody, const struct SourceMap* map);
 
-Variable* getVariable(const char* name) {
-    for (int i = 0; i < varCount; i++) {
-        if (strcmp(variables[i].name, name) == 0) {
-            return &variables[i];
+Variable* findVariable(VariableStore* store, const char* name) {
+    for (int i = 0; i < store->count; i++) {
+        if (strcmp(store->names[i], name) == 0) {
+            return &store->vars[i];
         }
     }
     return NULL;
 }
 
-char* concatStrings(const char* str1, const char* str2) {
-    size_t len1 = strlen(str1);
-    size_t len2 = strlen(str2);
-    char* result = (char*)malloc(len1 + len2 + 1); // +1 for the null-terminator
-    strcpy(result, str1);
-    strcat(result, str2);
-    return result;
+Variable* getVariable(const char* name) {
+    return findVariable(&variables, name);
+}
+
+const char* variableName(const Variable* var) {
+    return variables.names[var - variables.vars];
+}
+
+/* Bytes one variable of the type takes in the store */
+long long variableSize(VarType type) {
+    return sizeof(Variable) + sizeof(variables.names[0]) + (type == INT ? sizeof(int) : sizeof(TextBuffer));
 }
 
-char* subtractStrings(const char* str, const char* sub) {
+/* Removes the first occurrence of sub from str in place and returns the new length */
+size_t subtractStrings(char* str, size_t length, const char* sub) {
     char* pos = strstr(str, sub);
-    if (!pos) return strdup(str); // sub not found in str
+    if (!pos) return length; // sub not found in str
+
+    size_t subLength = strlen(sub);
+    memmove(pos, pos + subLength, length - (pos - str) - subLength + 1); // keep the null-terminator
+    return length - subLength;
+}
+
+/* Only the program's own variables count toward textBytes; the fold and check passes keep
+   copies in stores of their own */
+int textCounted(const TextBuffer* text) {
+    return text >= variables.texts && text < variables.texts + MAX_VAR_COUNT;
+}
 
-    size_t len = strlen(str) - strlen(sub);
-    char* result = (char*)malloc(len + 1); // +1 for the null-terminator
+/* Makes room for a TEXT value of the given length, doubling the capacity as needed */
+void textReserve(TextBuffer* text, size_t length) {
+    if (length + 1 <= text->capacity) return;
+    size_t capacity = text->capacity ? text->capacity * 2 : 32;
+    while (capacity < length + 1) capacity *= 2;
+    if (textCounted(text)) {
+        if (textBytes + (long long)(capacity - text->capacity) > textLimit) {
+            stopRun(EXIT_TEXT_LIMIT, "Text limit exceeded");
+        }
+        textBytes += capacity - text->capacity;
+    }
+    text->data = (char*)memRealloc(MEM_TEXT, text->data, capacity);
+    text->capacity = capacity;
+}
 
-    strncpy(result, str, pos - str); // copy part before sub
-    result[pos - str] = '\0';   
-    strcat(result, pos + strlen(sub)); // copy part after sub
+void textFree(TextBuffer* text) {
+    if (textCounted(text)) textBytes -= text->capacity;
+    memFree(text->data);
+    text->data = NULL;
+    text->length = text->capacity = 0;
+}
 
-    return result;
+void textSet(TextBuffer* text, const char* value, size_t length) {
+    textReserve(text, length);
+    memmove(text->data, value, length);
+    text->data[length] = '\0';
+    text->length = length;
+}
+
+void textAppend(TextBuffer* text, const char* value, size_t length) {
+    textReserve(text, text->length + length);
+    memcpy(text->data + text->length, value, length);
+    text->length += length;
+    text->data[text->length] = '\0';
+}
+
+void textRemove(TextBuffer* text, const char* value) {
+    text->length = subtractStrings(text->data, text->length, value);
+}
+
+/* Adds a name with a zero or empty value; returns NULL when the store is full */
+Variable* addVariable(VariableStore* store, const char* name, VarType type) {
+    if (store->count >= MAX_VAR_COUNT) return NULL;
+    Variable* var = &store->vars[store->count];
+    strcpy(store->names[store->count], name);
+    store->count++;
+    var->type = type;
+    if (type == INT) {
+        var->slot = store->intCount++;
+        store->ints[var->slot] = 0;
+    } else {
+        var->slot = store->textCount++;
+        textSet(&store->texts[var->slot], "", 0);
+    }
+    return var;
 }
 
 void declareVariable(const char* name, VarType type, const char* value) {
-    if (varCount >= MAX_VAR_COUNT) {
+    Variable* var = addVariable(&variables, name, type);
+    if (var == NULL) {
         printf("Error: Too many variables declared.\n");
-        exit(1);
+        endRun(1);
     }
-
-    strcpy(variables[varCount].name, name);
-    variables[varCount].type = type;
+    memNote(MEM_VARIABLES, variableSize(type));
 
     if (type == INT) {
         if (value != NULL) {
             int intValue;
             sscanf(value, "IntConst(%d)", &intValue);
-            variables[varCount].intValue = intValue;
-        } else {
-            variables[varCount].intValue = 0;
+            variables.ints[var->slot] = intValue;
         }
-        printf("Declared variable: %s of type INT with value %d\n", name, variables[varCount].intValue);
+        if (!quietMode) printf("Declared variable: %s of type INT with value %d\n", name, variables.ints[var->slot]);
     } else {
         if (value != NULL) {
-            char buffer[MAX_STR_LEN];
+            char buffer[MAX_STR_LEN] = "";
             sscanf(value, "String(\"%255[^\"]\")", buffer);
-            strcpy(variables[varCount].strValue, buffer);
-        } else {
-            variables[varCount].strValue[0] = '\0';
+            textSet(&variables.texts[var->slot], buffer, strlen(buffer));
         }
-        printf("Declared variable: %s of type TEXT with value \"%s\"\n", name, variables[varCount].strValue);
+        if (!quietMode) printf("Declared variable: %s of type TEXT with value \"%s\"\n", name, variables.texts[var->slot].data);
     }
-
-    varCount++;
 }
 
 void handleDeclaration(const char* line) {
@@ -357,30 +775,22 @@ void handleDeclaration(const char* line) {
                 token = strtok(NULL, " ,.");
                 if (token != NULL && (strncmp(token, "IntConst(", 9) == 0 || strncmp(token, "String(", 7) == 0)) {
                     if (strncmp(token, "String(", 7) == 0) {
-                        // Allocate enough space for the entire string
-                        size_t valueLen = strlen(token);
-                        value = (char*)malloc(valueLen + 1);
-                        strcpy(value, token);
-
-                        char* endQuote = strstr(token, "\")");
-                        while (endQuote == NULL) {
+                        // Join the blank separated pieces of the string; appends keep it linear
+                        TextBuffer joined = { NULL, 0, 0 };
+                        bufferAppend(&joined, token, strlen(token));
+                        while (strstr(token, "\")") == NULL) {
                             token = strtok(NULL, " ,");
                             if (token == NULL) {
                                 printf("Error: Unterminated string.\n");
-                                free(value);
+                                memFree(joined.data);
                                 return;
                             }
-                            valueLen += strlen(token) + 1;
-                            value = (char*)realloc(value, valueLen + 1);
-                            strcat(value, " ");
-                            strcat(value, token);
-                            endQuote = strstr(token, "\")");
+                            bufferAppend(&joined, " ", 1);
+                            bufferAppend(&joined, token, strlen(token));
                         }
-
-                        // Null-terminate the final string
-                        value[valueLen] = '\0';
+                        value = joined.data;
                     } else {
-                        value = (char*)malloc(strlen(token) + 1);
+                        value = (char*)memAlloc(MEM_TEXT, strlen(token) + 1);
                         strcpy(value, token);
                     }
 
@@ -395,7 +805,7 @@ void handleDeclaration(const char* line) {
             declareVariable(varName, type, value);
 
             if (value) {
-                free(value);
+                memFree(value);
             }
         }
 
@@ -407,167 +817,178 @@ void handleDeclaration(const char* line) {
 
 
 
-void handleAssignment(const char* varName, const char* expression) {
-    Variable* var = getVariable(varName);
-    if (var == NULL) {
-        // Yeni bir değişken oluştur
-        if (varCount >= MAX_VAR_COUNT) {
-            printf("Error: Too many variables declared.\n");
-            exit(1);
-        }
-        strcpy(variables[varCount].name, varName);
+/* Finds the variable an expression operand names in store; constant folding passes its own
+   store and a lookup that only returns the values it knows */
+typedef Variable* (*VariableLookup)(const char* name);
 
-        // String içerip içermediğini kontrol et
-        if (strstr(expression, "String(") != NULL) {
-            variables[varCount].type = TEXT;
-            var = &variables[varCount];
-            varCount++;
-        } else {
-            variables[varCount].type = INT;
-            var = &variables[varCount];
-            varCount++;
-        }
-    }
+/* Evaluates an INT expression left to right and saturates it to 0..MAX_INT.
+   Errors are printed only when report is set; returns 0 on an error. */
+int evaluateInt(const char* expression, const VariableStore* store, VariableLookup lookup, int report, int* value) {
+    int result = 0;
+    char* exprCopy = memStrdup(MEM_TEMP, expression);
+    char* token = strtok(exprCopy, " ");
+    int lastOperation = 1; // 1: ekleme, -1: çıkarma
 
-    if (var->type == INT) {
-        int result = 0;
-        char* exprCopy = strdup(expression);
-        char* token = strtok(exprCopy, " ");
-        int lastOperation = 1; // 1: ekleme, -1: çıkarma
-
-        while (token != NULL) {
-            if (strncmp(token, "IntConst(", 9) == 0) {
-                int num;
-                sscanf(token, "IntConst(%d)", &num);
-                result += lastOperation * num;
-            } else if (strncmp(token, "Identifier(", 11) == 0) {
-                char otherVarName[32];
-                sscanf(token, "Identifier(%31[^)])", otherVarName);
-                Variable* other = getVariable(otherVarName);
-                if (other != NULL && other->type == INT) {
-                    result += lastOperation * other->intValue;
-                } else {
-                    printf("Error: Invalid integer assignment for %s.\n", otherVarName);
-                    free(exprCopy);
-                    return;
-                }
-            } else if (strcmp(token, "Operator(/)") == 0) {
-                token = strtok(NULL, " ");
-                if (token != NULL && strncmp(token, "IntConst(", 9) == 0) {
-                    int divisor;
-                    sscanf(token, "IntConst(%d)", &divisor);
-                    if (divisor != 0) {
-                        result /= divisor;
-                    } else {
-                        printf("Error: Division by zero.\n");
-                        free(exprCopy);
-                        return;
-                    }
+    while (token != NULL) {
+        if (strncmp(token, "IntConst(", 9) == 0) {
+            int num;
+            sscanf(token, "IntConst(%d)", &num);
+            result += lastOperation * num;
+        } else if (strncmp(token, "Identifier(", 11) == 0) {
+            char otherVarName[32];
+            sscanf(token, "Identifier(%31[^)])", otherVarName);
+            Variable* other = lookup(otherVarName);
+            if (other != NULL && other->type == INT) {
+                result += lastOperation * store->ints[other->slot];
+            } else {
+                if (report) printf("Error: Invalid integer assignment for %s.\n", otherVarName);
+                memFree(exprCopy);
+                return 0;
+            }
+        } else if (strcmp(token, "Operator(/)") == 0) {
+            token = strtok(NULL, " ");
+            if (token != NULL && strncmp(token, "IntConst(", 9) == 0) {
+                int divisor;
+                sscanf(token, "IntConst(%d)", &divisor);
+                if (divisor != 0) {
+                    result /= divisor;
                 } else {
-                    printf("Error: Invalid expression.\n");
-                    free(exprCopy);
-                    return;
+                    if (report) printf("Error: Division by zero.\n");
+                    memFree(exprCopy);
+                    return 0;
                 }
-            } else if (strcmp(token, "Operator(+)") == 0) {
-                lastOperation = 1; // Sonraki işlemi toplama olarak ayarla
-            } else if (strcmp(token, "Operator(-)") == 0) {
-                lastOperation = -1; // Sonraki işlemi çıkarma olarak ayarla
             } else {
-                printf("Error: Unexpected token %s.\n", token);
-                free(exprCopy);
-                return;
+                if (report) printf("Error: Invalid expression.\n");
+                memFree(exprCopy);
+                return 0;
             }
-            token = strtok(NULL, " ");
+        } else if (strcmp(token, "Operator(+)") == 0) {
+            lastOperation = 1; // Sonraki işlemi toplama olarak ayarla
+        } else if (strcmp(token, "Operator(-)") == 0) {
+            lastOperation = -1; // Sonraki işlemi çıkarma olarak ayarla
+        } else {
+            if (report) printf("Error: Unexpected token %s.\n", token);
+            memFree(exprCopy);
+            return 0;
         }
-        var->intValue = result < 0 ? 0 : (result > MAX_INT ? MAX_INT : result);
-        printf("Assigned %d to variable %s\n", var->intValue, varName);
-        free(exprCopy);
-    } 
-    else if (var->type == TEXT) {
-        // Handle assignment to TEXT variable
-        char result[MAX_STR_LEN] = ""; // Sonuç string'i başlat
-        char* exprCopy = strdup(expression); // İfadeyi kopyala
-        char* token = strtok(exprCopy, " "); // İfadeyi token'lara ayır
-        int isAddition = 1; // Başlangıçta toplama işlemi varsayılsın
-
-        while (token != NULL) { // Tüm token'ları işleyene kadar devam et
-            if (strcmp(token, "Keyword(is)") == 0) {
-                // 'is' keywordünü atla ve bir sonraki token'a geç
-                token = strtok(NULL, " ");
-                continue;
-            } else if (strcmp(token, "Operator(+)") == 0) {
-                // Eğer operatör + ise sonuca ekleme işlemi yap
-                isAddition = 1;
-            } else if (strcmp(token, "Operator(-)") == 0) {
-                // Eğer operatör - ise sonuca çıkarma işlemi yap
-                isAddition = 0;
-            } else if (strncmp(token, "String(", 7) == 0) {
-                char str[MAX_STR_LEN] = "";
-                // String'in tamamını al
-                size_t len = strlen(token);
-                if (token[len - 1] != ')') {
-                    // Eğer token ')' ile bitmiyorsa, devamındaki token'ları birleştir
-                    strcat(str, token + 7); // "String(" kısmını atla
-                    while ((token = strtok(NULL, " ")) != NULL) {
-                        len = strlen(token);
-                        strcat(str, " ");
-                        strcat(str, token);
-                        if (token[len - 1] == ')') {
-                            str[strlen(str) - 1] = '\0'; // Kapanış parantezini kaldır
-                            break;
-                        }
+        token = strtok(NULL, " ");
+    }
+    *value = result < 0 ? 0 : (result > MAX_INT ? MAX_INT : result);
+    memFree(exprCopy);
+    return 1;
+}
+
+/* Evaluates a TEXT expression into result: + appends, - removes the first occurrence.
+   Errors are printed only when report is set; returns 0 on an error. */
+int evaluateText(const char* expression, const VariableStore* store, VariableLookup lookup, int report, TextBuffer* result) {
+    char* exprCopy = memStrdup(MEM_TEMP, expression); // İfadeyi kopyala
+    char* token = strtok(exprCopy, " "); // İfadeyi token'lara ayır
+    int isAddition = 1; // Başlangıçta toplama işlemi varsayılsın
+    bufferAppend(result, "", 0); // Sonuç string'i başlat
+
+    while (token != NULL) { // Tüm token'ları işleyene kadar devam et
+        if (strcmp(token, "Keyword(is)") == 0) {
+            // 'is' keywordünü atla ve bir sonraki token'a geç
+            token = strtok(NULL, " ");
+            continue;
+        } else if (strcmp(token, "Operator(+)") == 0) {
+            // Eğer operatör + ise sonuca ekleme işlemi yap
+            isAddition = 1;
+        } else if (strcmp(token, "Operator(-)") == 0) {
+            // Eğer operatör - ise sonuca çıkarma işlemi yap
+            isAddition = 0;
+        } else if (strncmp(token, "String(", 7) == 0) {
+            char str[MAX_STR_LEN] = "";
+            // String'in tamamını al
+            size_t len = strlen(token);
+            if (token[len - 1] != ')') {
+                // Eğer token ')' ile bitmiyorsa, devamındaki token'ları birleştir
+                strcat(str, token + 7); // "String(" kısmını atla
+                while ((token = strtok(NULL, " ")) != NULL) {
+                    len = strlen(token);
+                    strcat(str, " ");
+                    strcat(str, token);
+                    if (token[len - 1] == ')') {
+                        str[strlen(str) - 1] = '\0'; // Kapanış parantezini kaldır
+                        break;
                     }
-                } else {
-                    // Eğer token ')' ile bitiyorsa, sadece string içeriğini al
-                    sscanf(token, "String(\"%255[^\"]", str); // String değerini al
                 }
+            } else {
+                // Eğer token ')' ile bitiyorsa, sadece string içeriğini al
+                sscanf(token, "String(\"%255[^\"]", str); // String değerini al
+            }
 
-                // Son string'deki " karakterlerini kaldır
-                char tempStr[MAX_STR_LEN] = "";
-                char* p = str;
-                char* q = tempStr;
-                while (*p) {
-                    if (*p != '\"') {
-                        *q++ = *p;
-                    }
-                    p++;
+            // Son string'deki " karakterlerini kaldır
+            char tempStr[MAX_STR_LEN] = "";
+            char* p = str;
+            char* q = tempStr;
+            while (*p) {
+                if (*p != '\"') {
+                    *q++ = *p;
                 }
-                *q = '\0';
+                p++;
+            }
+            *q = '\0';
 
+            if (isAddition) {
+                bufferAppend(result, tempStr, strlen(tempStr)); // Sonuca ekle
+            } else {
+                result->length = subtractStrings(result->data, result->length, tempStr); // Sonucu güncelle
+            }
+        } else if (strncmp(token, "Identifier(", 11) == 0) {
+            char otherVarName[32];
+            sscanf(token, "Identifier(%31[^)])", otherVarName); // Diğer değişken ismini al
+            Variable* other = lookup(otherVarName); // Diğer değişkeni getir
+            if (other != NULL && other->type == TEXT) {
+                const TextBuffer* otherText = &store->texts[other->slot];
                 if (isAddition) {
-                    strcat(result, tempStr); // Sonuca ekle
-                } else {
-                    char* removedStr = subtractStrings(result, tempStr); // Sonucu güncelle
-                    strcpy(result, removedStr);
-                    free(removedStr);
-                }
-            } else if (strncmp(token, "Identifier(", 11) == 0) {
-                char otherVarName[32];
-                sscanf(token, "Identifier(%31[^)])", otherVarName); // Diğer değişken ismini al
-                Variable* other = getVariable(otherVarName); // Diğer değişkeni getir
-                if (other != NULL && other->type == TEXT) {
-                    if (isAddition) {
-                        strcat(result, other->strValue); // Diğer değişkenin değerini sonuca ekle
-                    } else {
-                        char* removedStr = subtractStrings(result, other->strValue); // Sonucu güncelle
-                        strcpy(result, removedStr);
-                        free(removedStr);
-                    }
+                    bufferAppend(result, otherText->data, otherText->length); // Diğer değişkenin değerini sonuca ekle
                 } else {
-                    printf("Error: Invalid text assignment for %s.\n", otherVarName);
-                    free(exprCopy); // Hatalı durumda belleği temizle ve çık
-                    return;
+                    result->length = subtractStrings(result->data, result->length, otherText->data); // Sonucu güncelle
                 }
             } else {
-                printf("Error: Unexpected token %s.\n", token);
-                free(exprCopy); // Beklenmeyen token durumunda çık
-                return;
+                if (report) printf("Error: Invalid text assignment for %s.\n", otherVarName);
+                memFree(exprCopy); // Hatalı durumda belleği temizle ve çık
+                return 0;
             }
-            token = strtok(NULL, " "); // Bir sonraki token'a geç
+        } else {
+            if (report) printf("Error: Unexpected token %s.\n", token);
+            memFree(exprCopy); // Beklenmeyen token durumunda çık
+            return 0;
         }
-        strcpy(var->strValue, result); // Sonucu değişkene ata
-        printf("Assigned \"%s\" to variable %s\n", var->strValue, varName);
-        free(exprCopy); // Belleği temizle
+        token = strtok(NULL, " "); // Bir sonraki token'a geç
+    }
+    memFree(exprCopy); // Belleği temizle
+    return 1;
+}
+
+void handleAssignment(const char* varName, const char* expression) {
+    Variable* var = getVariable(varName);
+    if (var == NULL) {
+        // Yeni bir değişken oluştur; String içerip içermediğine göre türünü belirle
+        VarType type = strstr(expression, "String(") != NULL ? TEXT : INT;
+        var = addVariable(&variables, varName, type);
+        if (var == NULL) {
+            printf("Error: Too many variables declared.\n");
+            endRun(1);
+        }
+        memNote(MEM_VARIABLES, variableSize(type));
+    }
+
+    if (var->type == INT) {
+        int value;
+        if (!evaluateInt(expression, &variables, getVariable, 1, &value)) return;
+        variables.ints[var->slot] = value;
+        if (!quietMode) printf("Assigned %d to variable %s\n", value, varName);
+    } 
+    else if (var->type == TEXT) {
+        // Handle assignment to TEXT variable
+        TextBuffer result = { NULL, 0, 0 };
+        if (evaluateText(expression, &variables, getVariable, 1, &result)) {
+            textSet(&variables.texts[var->slot], result.data, result.length); // Sonucu değişkene ata
+            if (!quietMode) printf("Assigned \"%s\" to variable %s\n", variables.texts[var->slot].data, varName);
+        }
+        memFree(result.data);
     }
     
     else {
@@ -575,307 +996,3558 @@ void handleAssignment(const char* varName, const char* expression) {
     }
 }
 
-void handleIO(const char* command, const char* line) {
-    // Eğer komut "Keyword(write)" ise
-    if (strcmp(command, "Keyword(write)") == 0) {
-        // Satırı parçalara ayır
-        char* token = strtok((char*)line, " ,.");
-        // Parçaları tara
-        while (token != NULL) {
-            // Eğer parça "String(" ile başlıyorsa
-            if (strncmp(token, "String(", 7) == 0) {
-                // String değerini al
-                char str[MAX_STR_LEN];
-                if (sscanf(token, "String(\"%255[^\"])\"", str) == 1) {
-                    printf("%s", str);
-                } else {
-                    printf(" ");
-                }
+/* Superinstructions: "x is x + <constant>" and "x is x - <constant>" update x in place
+   instead of copying, tokenizing and rebuilding the value in handleAssignment */
+typedef enum { FUSED_INT_ADD, FUSED_TEXT_APPEND, FUSED_TEXT_REMOVE } FusedKind;
 
-            // Eğer parça "Identifier(" ile başlıyorsa
-            } else if (strncmp(token, "Identifier(", 11) == 0) {
-                // Değişken adını al
-                char varName[32];
-                sscanf(token, "Identifier(%31[^)])", varName);
-                // Değişkeni al
-                Variable* var = getVariable(varName);
-                // Eğer değişken varsa
-                if (var != NULL) {
-                    // Eğer değişken türü INT ise
-                    if (var->type == INT) printf("%d", var->intValue);
-                    // Değilse, string ise
-                    else printf("%s", var->strValue);
-                } else {
-                    // Hata: Tanımlanmamış değişken
-                    printf("Error: Tanımlanmamış değişken %s.\n", varName);
-                }
-            }
-            // Bir sonraki parçaya geç
-            token = strtok(NULL, " ,.");
-        }
-        // Yeni satıra geç
-        printf("\n");
+typedef struct {
+    FusedKind kind;
+    char varName[32];
+    Variable* var;              // Resolved on first use by loop statements
+    int amount;                 // FUSED_INT_ADD: the constant, negative for subtraction
+    char text[MAX_STR_LEN];     // FUSED_TEXT_*: the string constant without its quotes
+    size_t textLength;
+} FusedAssignment;
 
-    // Eğer komut "Keyword(read)" ise
-    } else if (strcmp(command, "Keyword(read)") == 0) {
-        // İstenen bilgiyi ve değişken adını al
-        char prompt[MAX_STR_LEN], varName[32];
-        sscanf(line, "String(\"%255[^\"]\") Identifier(%31[^)])", prompt, varName);
-        // Değişkeni al
-        Variable* var = getVariable(varName);
-        // Eğer değişken yoksa
-        if (var == NULL) {
-            // Hata: Tanımlanmamış değişken
-            printf("Error: Tanımlanmamış değişken %s.\n", varName);
-            return;
-        }
-        // Kullanıcıya istenen bilgiyi göster
-        printf("%s", prompt);
-        // Eğer değişken türü INT ise
-        if (var->type == INT) {
-            // INT tipinde giriş al
-            if (scanf("%d", &var->intValue) != 1) {
-                // Uyarı: Geçersiz giriş
-                printf("Warning: Geçersiz tam sayı girişi. %s için 0 atandı.\n", varName);
-                var->intValue = 0;
-            }
-        // Değilse, string ise
-        } else {
-            scanf("%s", var->strValue);
-        }
+/* Recognizes "Identifier(x) Keyword(is) Identifier(x) Operator(+|-) <constant>". Constants
+   that handleAssignment would reshape (repeated blanks, ')' inside) are left to it. */
+int parseFusedAssignment(const char* line, FusedAssignment* fused) {
+    char sourceName[32], op;
+    int constantStart = -1, constantEnd = -1;
+    if (strncmp(line, "Identifier(", 11) != 0) return 0;
+    sscanf(line, "Identifier(%31[^)]) Keyword(is) Identifier(%31[^)]) Operator(%c) %n",
+           fused->varName, sourceName, &op, &constantStart);
+    if (constantStart < 0 || strcmp(fused->varName, sourceName) != 0 || (op != '+' && op != '-')) return 0;
 
-    // Eğer komut "Keyword(newLine)" ise
-    } else if (strcmp(command, "Keyword(newLine)") == 0) {
-        // Yeni satıra geç
-        printf("\n");
+    const char* constant = line + constantStart;
+    fused->var = NULL;
+    if (sscanf(constant, "IntConst(%d)%n", &fused->amount, &constantEnd) == 1 && constant[constantEnd] == '\0') {
+        fused->kind = FUSED_INT_ADD;
+        if (op == '-') fused->amount = -fused->amount;
+        return 1;
     }
-}
+    if (strncmp(constant, "String(\"", 8) != 0) return 0;
 
+    const char* start = constant + 8;
+    const char* end = strchr(start, '"');
+    if (end == NULL || strcmp(end, "\")") != 0 || end - start >= MAX_STR_LEN) return 0;
+    for (const char* p = start; p < end; p++) {
+        if (*p == ')' || (p[0] == ' ' && p[1] == ' ')) return 0;
+    }
+    fused->kind = op == '+' ? FUSED_TEXT_APPEND : FUSED_TEXT_REMOVE;
+    fused->textLength = end - start;
+    memcpy(fused->text, start, fused->textLength);
+    fused->text[fused->textLength] = '\0';
+    return 1;
+}
 
-// handleLoop fonksiyonu
-void handleLoop(int loopCount, const char* loopBody) {
-    char loopBodyCopy[4096];
-    strcpy(loopBodyCopy, loopBody);
-    int incrementValue = 1; // Varsayılan artış miktarı
+/* Runs a recognized update; returns 0 when var does not fit it and handleAssignment must decide */
+int runFusedAssignment(const FusedAssignment* fused, Variable* var) {
+    if (var == NULL) return 0;
+    if (fused->kind == FUSED_INT_ADD) {
+        if (var->type != INT) return 0;
+        int* slot = &variables.ints[var->slot];
+        int result = *slot + fused->amount;
+        *slot = result < 0 ? 0 : (result > MAX_INT ? MAX_INT : result);
+        if (!quietMode) printf("Assigned %d to variable %s\n", *slot, fused->varName);
+        return 1;
+    }
 
-    // Döngü gövdesini tarayarak 'i' değişkeninin artış miktarını belirle
-    char* token = strtok(loopBodyCopy, " ");
-    while (token != NULL) {
-        if (strncmp(token, "Identifier(i)", 13) == 0) {
-            char* nextToken = strtok(NULL, " ");
-            if (nextToken != NULL && strcmp(nextToken, "Keyword(is)") == 0) {
-                nextToken = strtok(NULL, " ");
-                if (nextToken != NULL && strncmp(nextToken, "Identifier(i)", 13) == 0) {
-                    nextToken = strtok(NULL, " ");
-                    if (nextToken != NULL && strcmp(nextToken, "Operator(+)") == 0) {
-                        nextToken = strtok(NULL, " ");
-                        if (nextToken != NULL && strncmp(nextToken, "IntConst(", 9) == 0) {
-                            sscanf(nextToken, "IntConst(%d)", &incrementValue);
-                        }
-                    }
-                }
-            }
-        }
-        token = strtok(NULL, " ");
+    if (var->type != TEXT) return 0;
+    TextBuffer* text = &variables.texts[var->slot];
+    if (fused->kind == FUSED_TEXT_APPEND) {
+        textAppend(text, fused->text, fused->textLength);
+    } else {
+        textRemove(text, fused->text);
     }
+    if (!quietMode) printf("Assigned \"%s\" to variable %s\n", text->data, fused->varName);
+    return 1;
+}
 
-    for (int i = 0; i < loopCount; i++) {
-        printf("Loop iteration %d:\n", i + 1);
-
-        strcpy(loopBodyCopy, loopBody); // loopBodyCopy'yi tekrar doldur
-        char* token = strtok(loopBodyCopy, " ");
-        char statement[1024] = {0};
-        int inStatement = 0;
-        int inInnerLoop = 0;
-        int innerLoopActive = 0;
-        char innerLoopBody[4096] = {0};
-        int innerLoopCount = 0;
-        int loopKeywordEncountered = 0; // iç döngü bayrağı
-
-        while (token != NULL) {
-            if (innerLoopActive) {
-                if (strcmp(token, "LeftCurlyBracket") == 0) {
-                    inInnerLoop = 1;
-                } else if (strcmp(token, "RightCurlyBracket") == 0) {
-                    inInnerLoop = 0;
-                    innerLoopActive = 0;
-                    handleLoop(innerLoopCount, innerLoopBody); // İç döngüyü işle
-                    innerLoopBody[0] = '\0'; // İç döngü gövdesini sıfırla
-                    token = strtok(NULL, " ");
-                    continue;
-                }
-                strcat(innerLoopBody, token);
-                strcat(innerLoopBody, " ");
-            } else if (strncmp(token, "Keyword(loop)", 13) == 0) {
-
-                loopKeywordEncountered = 1; // iç döngü bayrağını etkinleştir
-                token = strtok(NULL, " ");
-                if (token != NULL && strncmp(token, "IntConst(", 9) == 0) {
-                    sscanf(token, "IntConst(%d)", &innerLoopCount);
-                    // Ardından Keyword(times) tokenini bekle
-                    token = strtok(NULL, " ");
-                    if (token != NULL && strcmp(token, "Keyword(times)") == 0) {
-                        innerLoopActive = 1;
-                        token = strtok(NULL, " ");
-                        continue;
+/* Buffered standard input for read: large blocks are pulled with fread and values are
+   parsed straight out of the buffer instead of one scanf call per value. A terminal or pipe
+   is read with read(), which returns what has arrived instead of waiting for a full block. */
+#define INPUT_BUFFER_SIZE 65536
+
+typedef struct {
+    char data[INPUT_BUFFER_SIZE];
+    size_t position;        // Next unread byte
+    size_t length;          // Bytes in data
+    FILE* file;             // Source of the data, NULL for stdin
+} InputReader;
+
+InputReader standardInput;
+InputReader* input = &standardInput;    // Reader of the running script
+
+#if SCHEDULER_SUPPORTED
+size_t scriptRead(char* data, size_t size);
+#endif
+
+/* Whether standard input delivers data as it is typed or written */
+int stdinIsStream(void) {
+    static int stream = -1;
+    if (stream < 0) {
+#ifdef _WIN32
+        stream = isatty(fileno(stdin));
+#else
+        struct stat info;
+        stream = fstat(fileno(stdin), &info) == 0 && (S_ISCHR(info.st_mode) || S_ISFIFO(info.st_mode) || S_ISSOCK(info.st_mode));
+#endif
+    }
+    return stream;
+}
+
+/* Next byte without consuming it, EOF when the input is exhausted */
+int inputPeek(void) {
+    if (input->position == input->length) {
+#if SCHEDULER_SUPPORTED
+        if (currentScript != NULL) {
+            input->length = scriptRead(input->data, INPUT_BUFFER_SIZE);    // May suspend the script
+        } else
+#endif
+        if (input->file == NULL && stdinIsStream()) {
+            fflush(stdout);                 // The prompt is shown before the wait
+            int count = (int)read(fileno(stdin), input->data, INPUT_BUFFER_SIZE);
+#ifndef _WIN32
+            while (count < 0 && errno == EINTR) count = (int)read(fileno(stdin), input->data, INPUT_BUFFER_SIZE);
+#endif
+            input->length = count > 0 ? (size_t)count : 0;
+        } else
+        input->length = fread(input->data, 1, INPUT_BUFFER_SIZE, input->file != NULL ? input->file : stdin);
+        input->position = 0;
+        if (input->length == 0) return EOF;
+    }
+    return (unsigned char)input->data[input->position];
+}
+
+void inputSkipSpace(void) {
+    int c;
+    while ((c = inputPeek()) != EOF && isspace(c)) input->position++;
+}
+
+/* Parses a decimal integer like scanf("%d"); on failure nothing but whitespace is consumed */
+int inputReadInt(int* value) {
+    inputSkipSpace();
+    int c = inputPeek();
+    int negative = 0;
+    if (c == '-' || c == '+') {
+        negative = c == '-';
+        input->position++;
+        c = inputPeek();
+        if (c == EOF || !isdigit(c)) return 0;
+    } else if (c == EOF || !isdigit(c)) {
+        return 0;
+    }
+
+    long long result = 0;
+    while ((c = inputPeek()) != EOF && isdigit(c)) {
+        if (result < 10000000000LL) result = result * 10 + (c - '0');   // Saturates below, never overflows
+        input->position++;
+    }
+    if (negative) result = -result;
+    *value = result > 2147483647LL ? 2147483647 : (result < -2147483647LL - 1 ? (int)(-2147483647LL - 1) : (int)result);
+    return 1;
+}
+
+/* Reads a whitespace delimited word like scanf("%s"), keeping at most size - 1 bytes of it */
+int inputReadWord(char* word, size_t size) {
+    inputSkipSpace();
+    size_t length = 0;
+    int c = inputPeek();
+    if (c == EOF) return 0;
+
+    while (c != EOF && !isspace(c)) {
+        // Copy the run of word bytes that is already buffered
+        size_t start = input->position;
+        while (input->position < input->length && !isspace((unsigned char)input->data[input->position])) {
+            input->position++;
+        }
+        size_t run = input->position - start;
+        if (length + run > size - 1) run = size - 1 - length;
+        memcpy(word + length, input->data + start, run);
+        length += run;
+        c = inputPeek();
+    }
+    word[length] = '\0';
+    return 1;
+}
+
+TextBuffer writeBuffer = { NULL, 0, 0 };     // Output of the current write statement
+
+/* Formats the output of a write statement into out; line is tokenized in place */
+void renderWrite(char* line, TextBuffer* out) {
+    // Satırı parçalara ayır
+    char* token = strtok(line, " ,.");
+    // Parçaları tara
+    while (token != NULL) {
+        // Eğer parça "String(" ile başlıyorsa
+        if (strncmp(token, "String(", 7) == 0) {
+            // String değerini al
+            char str[MAX_STR_LEN];
+            if (sscanf(token, "String(\"%255[^\"])\"", str) == 1) {
+                bufferAppend(out, str, strlen(str));
+            } else {
+                bufferAppend(out, " ", 1);
+            }
+
+        // Eğer parça "Identifier(" ile başlıyorsa
+        } else if (strncmp(token, "Identifier(", 11) == 0) {
+            // Değişken adını al
+            char varName[32];
+            sscanf(token, "Identifier(%31[^)])", varName);
+            // Değişkeni al
+            Variable* var = getVariable(varName);
+            // Eğer değişken varsa
+            if (var != NULL) {
+                // Eğer değişken türü INT ise
+                if (var->type == INT) {
+                    char number[16];
+                    bufferAppend(out, number, snprintf(number, sizeof(number), "%d", variables.ints[var->slot]));
+                // Değilse, string ise
+                } else {
+                    bufferAppend(out, variables.texts[var->slot].data, variables.texts[var->slot].length);
+                }
+            } else {
+                // Hata: Tanımlanmamış değişken
+                char message[64];
+                bufferAppend(out, message, snprintf(message, sizeof(message), "Error: Tanımlanmamış değişken %s.\n", varName));
+            }
+        }
+        // Bir sonraki parçaya geç
+        token = strtok(NULL, " ,.");
+    }
+    // Yeni satıra geç
+    bufferAppend(out, "\n", 1);
+}
+
+/* Shows the prompt and reads one value into var */
+void readValue(Variable* var, const char* prompt) {
+    // Kullanıcıya istenen bilgiyi göster (--prompt auto başlangıçta always ya da never olur)
+    if (promptMode == PROMPT_ALWAYS) {
+        printf("%s", prompt);
+    }
+    // Eğer değişken türü INT ise
+    if (var->type == INT) {
+        // INT tipinde giriş al
+        if (!inputReadInt(&variables.ints[var->slot])) {
+            // Uyarı: Geçersiz giriş
+            printf("Warning: Geçersiz tam sayı girişi. %s için 0 atandı.\n", variableName(var));
+            variables.ints[var->slot] = 0;
+        }
+    // Değilse, string ise
+    } else {
+        char word[MAX_STR_LEN];
+        if (inputReadWord(word, sizeof(word))) {
+            textSet(&variables.texts[var->slot], word, strlen(word));
+        }
+    }
+}
+
+void handleIO(const char* command, const char* line) {
+    // Eğer komut "Keyword(write)" ise
+    if (strcmp(command, "Keyword(write)") == 0) {
+        // Çıktıyı hazırla ve tek seferde yaz
+        bufferClear(&writeBuffer);
+        renderWrite((char*)line, &writeBuffer);
+        fwrite(writeBuffer.data, 1, writeBuffer.length, stdout);
+
+    // Eğer komut "Keyword(read)" ise
+    } else if (strcmp(command, "Keyword(read)") == 0) {
+        // İstenen bilgiyi (varsa) ve değişken adını al
+        char prompt[MAX_STR_LEN] = "", varName[32];
+        const char* target = line;
+        if (strncmp(line, "String(", 7) == 0) {
+            sscanf(line, "String(\"%255[^\"]\")", prompt);
+            target = strstr(line, "Identifier(");
+        }
+        if (target == NULL || sscanf(target, "Identifier(%31[^)])", varName) != 1) {
+            // Hata: Okunacak değişken yok
+            printf("Error: read needs a variable.\n");
+            return;
+        }
+        // Değişkeni al
+        Variable* var = getVariable(varName);
+        // Eğer değişken yoksa
+        if (var == NULL) {
+            // Hata: Tanımlanmamış değişken
+            printf("Error: Tanımlanmamış değişken %s.\n", varName);
+            return;
+        }
+        readValue(var, prompt);
+
+    // Eğer komut "Keyword(newLine)" ise
+    } else if (strcmp(command, "Keyword(newLine)") == 0) {
+        // Yeni satıra geç
+        printf("\n");
+    }
+}
+
+
+/* Reads a line of any length without its new line; returns 0 at the end of the file */
+int readLine(FILE* file, TextBuffer* buffer) {
+    char chunk[256];
+    bufferClear(buffer);
+    while (fgets(chunk, sizeof(chunk), file)) {
+        size_t length = strlen(chunk);
+        if (length > 0 && chunk[length - 1] == '\n') {
+            bufferAppend(buffer, chunk, length - 1);
+            return 1;
+        }
+        bufferAppend(buffer, chunk, length);
+    }
+    return buffer->length > 0;
+}
+
+
+/* Source position of a token, keyed by its offset in the statement text */
+typedef struct {
+    int offset;
+    int line;
+    int column;
+} TokenPos;
+
+/* Token positions of a statement text, sorted by offset */
+typedef struct SourceMap {
+    TokenPos* positions;
+    int count;
+    int capacity;
+} SourceMap;
+
+void addTokenPos(SourceMap* map, int offset, int line, int column) {
+    if (map->count == map->capacity) {
+        map->capacity = map->capacity ? map->capacity * 2 : 64;
+        map->positions = (TokenPos*)memRealloc(MEM_PROGRAM, map->positions, map->capacity * sizeof(TokenPos));
+    }
+    map->positions[map->count].offset = offset;
+    map->positions[map->count].line = line;
+    map->positions[map->count].column = column;
+    map->count++;
+}
+
+/* Position of the token at or before offset; 0:0 when unknown */
+void findTokenPos(const SourceMap* map, int offset, int* line, int* column) {
+    int low = 0, high = map != NULL ? map->count - 1 : -1, found = -1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (map->positions[mid].offset <= offset) {
+            found = mid;
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    *line = found >= 0 ? map->positions[found].line : 0;
+    *column = found >= 0 ? map->positions[found].column : 0;
+}
+
+/* Positions of [start, end) rebased to start */
+void subSourceMap(const SourceMap* map, int start, int end, SourceMap* out) {
+    out->positions = NULL;
+    out->count = 0;
+    out->capacity = 0;
+    if (map == NULL) return;
+
+    // Positions are sorted: find the first one at or after start
+    int low = 0, high = map->count;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (map->positions[mid].offset < start) low = mid + 1;
+        else high = mid;
+    }
+    for (int i = low; i < map->count && map->positions[i].offset < end; i++) {
+        addTokenPos(out, map->positions[i].offset - start, map->positions[i].line, map->positions[i].column);
+    }
+}
+
+
+/* Profiler: statements form a tree by loop nesting; each node counts its executions
+   and the time spent in it, nested statements included. Its own bookkeeping is not
+   part of the memory accounting. */
+typedef struct ProfileNode {
+    int line;
+    int column;
+    char kind[16];              // Statement keyword, "assign" or "loop"
+    char* text;                 // Statement tokens for the report
+    long long count;            // Executions
+    long long totalNs;          // Time including nested statements
+    long long childNs;          // Time spent in nested statements
+    struct ProfileNode* parent;
+    struct ProfileNode* children;
+    struct ProfileNode* next;   // Next sibling
+} ProfileNode;
+
+ProfileNode profileRoot;
+ProfileNode* profileCurrent = &profileRoot;
+
+long long profileNow(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+ProfileNode* profileEnter(int line, int column, const char* text) {
+    ProfileNode* node = profileCurrent->children;
+    while (node != NULL && (node->line != line || node->column != column)) node = node->next;
+
+    if (node == NULL) {
+        node = (ProfileNode*)calloc(1, sizeof(ProfileNode));
+        node->line = line;
+        node->column = column;
+        node->text = strdup(text);
+        if (sscanf(text, "Keyword(%15[^)])", node->kind) != 1) {
+            strcpy(node->kind, strncmp(text, "Identifier(", 11) == 0 ? "assign" : "stmt");
+        }
+        node->parent = profileCurrent;
+        node->next = profileCurrent->children;
+        profileCurrent->children = node;
+    }
+    node->count++;
+    profileCurrent = node;
+    return node;
+}
+
+void profileLeave(ProfileNode* node, long long start) {
+    long long elapsed = profileNow() - start;
+    node->totalNs += elapsed;
+    node->parent->childNs += elapsed;
+    profileCurrent = node->parent;
+}
+
+void collectProfileNodes(ProfileNode* node, ProfileNode*** nodes, int* count, int* capacity) {
+    for (ProfileNode* child = node->children; child != NULL; child = child->next) {
+        if (*count == *capacity) {
+            *capacity = *capacity ? *capacity * 2 : 64;
+            *nodes = (ProfileNode**)realloc(*nodes, *capacity * sizeof(ProfileNode*));
+        }
+        (*nodes)[(*count)++] = child;
+        collectProfileNodes(child, nodes, count, capacity);
+    }
+}
+
+int compareProfileNodes(const void* a, const void* b) {
+    const ProfileNode* x = *(ProfileNode* const*)a;
+    const ProfileNode* y = *(ProfileNode* const*)b;
+    if (x->totalNs != y->totalNs) return x->totalNs < y->totalNs ? 1 : -1;
+    return x->line != y->line ? x->line - y->line : x->column - y->column;
+}
+
+/* One "frame;frame;frame self_ns" line per node, the folded format of flamegraph tools */
+void writeFoldedStacks(FILE* out, ProfileNode* node, const char* prefix) {
+    for (ProfileNode* child = node->children; child != NULL; child = child->next) {
+        char* path = (char*)malloc(strlen(prefix) + 48);
+        sprintf(path, "%s%s%s@%d:%d", prefix, *prefix ? ";" : "", child->kind, child->line, child->column);
+        if (child->totalNs > child->childNs) {
+            fprintf(out, "%s %lld\n", path, child->totalNs - child->childNs);
+        }
+        writeFoldedStacks(out, child, path);
+        free(path);
+    }
+}
+
+/* Statements are nested statically, so each source position has exactly one node */
+void profileReport(void) {
+    ProfileNode** nodes = NULL;
+    int count = 0, capacity = 0;
+    collectProfileNodes(&profileRoot, &nodes, &count, &capacity);
+    qsort(nodes, count, sizeof(ProfileNode*), compareProfileNodes);
+
+    fprintf(stderr, "\nProfile (sorted by cumulative time):\n");
+    fprintf(stderr, "%10s %12s %12s %12s  %s\n", "line:col", "count", "total ms", "self ms", "statement");
+    for (int i = 0; i < count; i++) {
+        char position[24];
+        sprintf(position, "%d:%d", nodes[i]->line, nodes[i]->column);
+        fprintf(stderr, "%10s %12lld %12.3f %12.3f  %.60s\n", position, nodes[i]->count,
+                nodes[i]->totalNs / 1e6, (nodes[i]->totalNs - nodes[i]->childNs) / 1e6, nodes[i]->text);
+    }
+    free(nodes);
+
+    FILE* folded = fopen("code.folded", "w");
+    if (folded == NULL) {
+        printf("Error: Could not write code.folded.\n");
+        return;
+    }
+    writeFoldedStacks(folded, &profileRoot, "");
+    fclose(folded);
+    fprintf(stderr, "Folded stacks written to code.folded\n");
+}
+
+
+/* A statement of a loop body, split once before the iterations run */
+typedef struct {
+    char* text;             // Statement tokens without the closing EndOfLine, NULL for a nested loop
+    char* countToken;       // Nested loop count: IntConst(n) or Identifier(x)
+    char* body;             // Nested loop body tokens
+    SourceMap bodyMap;      // Nested loop body token positions
+    FusedAssignment* fused; // Self-referencing update run in place, or NULL
+    int line;               // Source position of the first token
+    int column;
+} LoopStmt;
+
+typedef struct {
+    LoopStmt* stmts;        // Statements in source order
+    int count;              // Number of statements
+    int capacity;           // Allocated statement slots
+} LoopBody;
+
+/* Returns the next blank separated token of a loop body and advances the cursor */
+const char* nextBodyToken(const char** cursor, size_t* len) {
+    const char* p = *cursor;
+    while (*p == ' ') p++;
+    *cursor = p;
+    if (*p == '\0') return NULL;
+
+    const char* start = p;
+    while (*p != '\0' && *p != ' ') p++;
+    *len = p - start;
+    *cursor = p;
+    return start;
+}
+
+int tokenIs(const char* token, size_t len, const char* expected) {
+    return strlen(expected) == len && strncmp(token, expected, len) == 0;
+}
+
+char* copyRange(const char* start, const char* end) {
+    char* result = (char*)memAlloc(MEM_PROGRAM, end - start + 1);
+    memcpy(result, start, end - start);
+    result[end - start] = '\0';
+    return result;
+}
+
+LoopStmt* addLoopStmt(LoopBody* body, char* text, const SourceMap* map, int offset) {
+    if (body->count == body->capacity) {
+        body->capacity = body->capacity ? body->capacity * 2 : 8;
+        body->stmts = (LoopStmt*)memRealloc(MEM_PROGRAM, body->stmts, body->capacity * sizeof(LoopStmt));
+    }
+    LoopStmt* stmt = &body->stmts[body->count++];
+    memset(stmt, 0, sizeof(LoopStmt));
+    stmt->text = text;
+    findTokenPos(map, offset, &stmt->line, &stmt->column);
+
+    FusedAssignment fused;
+    if (text != NULL && parseFusedAssignment(text, &fused)) {
+        stmt->fused = (FusedAssignment*)memAlloc(MEM_PROGRAM, sizeof(FusedAssignment));
+        *stmt->fused = fused;
+    }
+    return stmt;
+}
+
+/* Splits loop body tokens into statements; nested loops keep their own body text */
+void splitLoopBody(const char* loopBody, const SourceMap* map, LoopBody* out) {
+    const char* cursor = loopBody;
+    const char* token;
+    const char* stmtStart = NULL;
+    const char* stmtEnd = NULL;
+    size_t len;
+
+    out->stmts = NULL;
+    out->count = 0;
+    out->capacity = 0;
+
+    while ((token = nextBodyToken(&cursor, &len)) != NULL) {
+        if (tokenIs(token, len, "EndOfLine")) {
+            if (stmtStart != NULL) {
+                addLoopStmt(out, copyRange(stmtStart, stmtEnd), map, stmtStart - loopBody);
+                stmtStart = NULL;
+            }
+        } else if (stmtStart == NULL && tokenIs(token, len, "Keyword(loop)")) {
+            size_t countLen = 0;
+            const char* countToken = nextBodyToken(&cursor, &countLen);
+            const char* times = countToken != NULL ? nextBodyToken(&cursor, &len) : NULL;
+            if (times == NULL || !tokenIs(times, len, "Keyword(times)")) {
+                printf("Error: Expected 'times' after the loop count.\n");
+                return;
+            }
+
+            const char* bodyStart = cursor;
+            const char* bodyEnd = NULL;
+            const char* next = nextBodyToken(&cursor, &len);
+            int depth = 0;
+            if (next != NULL && tokenIs(next, len, "LeftCurlyBracket")) {
+                // Braced body: everything up to the matching RightCurlyBracket
+                bodyStart = cursor;
+                depth = 1;
+                while ((next = nextBodyToken(&cursor, &len)) != NULL) {
+                    if (tokenIs(next, len, "LeftCurlyBracket")) {
+                        depth++;
+                    } else if (tokenIs(next, len, "RightCurlyBracket") && --depth == 0) {
+                        bodyEnd = next;
+                        break;
                     }
                 }
-            } else if (strncmp(token, "Keyword(times)", 14) == 0) {
-                // İç döngü bayrağını kontrol et
-                if (loopKeywordEncountered) {
-                    loopKeywordEncountered = 0; // iç döngü bayrağını devre dışı bırak
-                    inStatement = 1; // iç döngü gövdesini toplamaya başla
+                if (bodyEnd == NULL) {
+                    printf("Error: Missing RightCurlyBracket in loop.\n");
+                    return;
                 }
-            } else if (strncmp(token, "LeftCurlyBracket", 16) == 0) {
-                inInnerLoop = 1;
-            } else if (strncmp(token, "Keyword", 7) == 0) {
-                inStatement = 1;
-            }
-
-            if (inStatement && !inInnerLoop && !innerLoopActive) {
-                strcat(statement, token);
-                strcat(statement, " ");
-                if (strcmp(token, "EndOfLine") == 0) {
-                    execute(statement);
-                    statement[0] = '\0';
-                    inStatement = 0;
+            } else {
+                // Single statement body: up to its EndOfLine, or a whole nested braced loop
+                while (next != NULL) {
+                    if (tokenIs(next, len, "LeftCurlyBracket")) {
+                        depth++;
+                    } else if (tokenIs(next, len, "RightCurlyBracket")) {
+                        if (--depth == 0) break;
+                    } else if (depth == 0 && tokenIs(next, len, "EndOfLine")) {
+                        break;
+                    }
+                    next = nextBodyToken(&cursor, &len);
                 }
+                bodyEnd = cursor;
+            }
+            LoopStmt* loop = addLoopStmt(out, NULL, map, token - loopBody);
+            loop->countToken = copyRange(countToken, countToken + countLen);
+            loop->body = copyRange(bodyStart, bodyEnd);
+            subSourceMap(map, bodyStart - loopBody, bodyEnd - loopBody, &loop->bodyMap);
+        } else if (!tokenIs(token, len, "LeftCurlyBracket") && !tokenIs(token, len, "RightCurlyBracket")) {
+            if (stmtStart == NULL) stmtStart = token;
+            stmtEnd = token + len;
+        }
+    }
+
+    // The last statement of a body may omit its '.'
+    if (stmtStart != NULL) {
+        addLoopStmt(out, copyRange(stmtStart, stmtEnd), map, stmtStart - loopBody);
+    }
+}
+
+void freeLoopBody(LoopBody* body) {
+    for (int i = 0; i < body->count; i++) {
+        memFree(body->stmts[i].text);
+        memFree(body->stmts[i].countToken);
+        memFree(body->stmts[i].body);
+        memFree(body->stmts[i].bodyMap.positions);
+        memFree(body->stmts[i].fused);
+    }
+    memFree(body->stmts);
+}
+
+int loopCountOf(const char* countToken) {
+    int count = 0;
+    char varName[32];
+    if (sscanf(countToken, "IntConst(%d)", &count) == 1) {
+        return count;
+    }
+    if (sscanf(countToken, "Identifier(%31[^)])", varName) == 1) {
+        Variable* var = getVariable(varName);
+        if (var != NULL && var->type == INT) return variables.ints[var->slot];
+    }
+    printf("Error: Invalid loop count %s.\n", countToken);
+    return 0;
+}
+
+void runLoopStmt(const LoopStmt* stmt) {
+    ProfileNode* node = NULL;
+    long long start = 0;
+    if (profileEnabled) {
+        if (stmt->text != NULL) {
+            node = profileEnter(stmt->line, stmt->column, stmt->text);
+        } else {
+            char header[64];
+            snprintf(header, sizeof(header), "Keyword(loop) %s Keyword(times)", stmt->countToken);
+            node = profileEnter(stmt->line, stmt->column, header);
+        }
+        start = profileNow();
+    }
+
+    FusedAssignment* fused = stmt->fused;
+    if (fused != NULL && fused->var == NULL) fused->var = getVariable(fused->varName);
+
+    if (stmt->text == NULL) {
+        handleLoop(loopCountOf(stmt->countToken), stmt->body, &stmt->bodyMap);
+    } else if (fused != NULL && runFusedAssignment(fused, fused->var)) {
+        statementCount++;
+    } else {
+        char* line = memStrdup(MEM_TEMP, stmt->text);  // The handlers tokenize the line in place
+        execute(line);
+        memFree(line);
+    }
+
+    if (node != NULL) profileLeave(node, start);
+}
+
+/* Runs "Keyword(loop) <count> Keyword(times) <body>" */
+void handleLoopStatement(const char* line, const SourceMap* map) {
+    LoopBody loop;
+    splitLoopBody(line, map, &loop);
+    for (int k = 0; k < loop.count; k++) {
+        runLoopStmt(&loop.stmts[k]);
+    }
+    freeLoopBody(&loop);
+}
+
+
+/* Checkpoints: a snapshot holds the variable table, the loops in progress and the position
+   of the next statement, so a restarted run can continue where the snapshot was taken.
+   Snapshots are written at statement boundaries, every --checkpoint-every statements or
+   when SIGUSR1 arrives. The format uses native byte order:
+     "LXCP" version scriptHash topStatement statementCount
+     varCount { nameLength name type (int value | textLength text) }
+     loopDepth { count iteration statement } */
+#define CHECKPOINT_VERSION 1
+
+typedef struct {
+    int count;              // Iterations of the loop, fixed when it started
+    int iteration;          // Iteration in progress, from 0
+    int stmt;               // Body statement about to run
+} LoopFrame;
+
+LoopFrame* loopFrames = NULL;       // Loops in progress, outermost first
+int loopDepth = 0;
+int loopFramesCapacity = 0;
+long long topStatementIndex = 0;    // Top-level statements started before the current one
+
+int checkpointEnabled = 0;          // --checkpoint: snapshots may be written
+const char* checkpointPath = NULL;
+long long checkpointEvery = 0;      // --checkpoint-every: statements between snapshots
+long long nextCheckpointAt = 0;
+volatile sig_atomic_t checkpointRequested = 0;
+unsigned long long scriptHash = 0;  // FNV-1a of code.sta; a snapshot only resumes its own script
+
+int resuming = 0;                   // Skipping ahead to the position of a loaded snapshot
+long long resumeTop = 0;
+LoopFrame* resumeFrames = NULL;
+int resumeDepth = 0;
+
+int pushLoopFrame(int count) {
+    if (loopDepth == loopFramesCapacity) {
+        loopFramesCapacity = loopFramesCapacity ? loopFramesCapacity * 2 : 8;
+        loopFrames = (LoopFrame*)memRealloc(MEM_PROGRAM, loopFrames, loopFramesCapacity * sizeof(LoopFrame));
+    }
+    loopFrames[loopDepth].count = count;
+    loopFrames[loopDepth].iteration = 0;
+    loopFrames[loopDepth].stmt = 0;
+    return loopDepth++;
+}
+
+void requestCheckpoint(int sig) {
+    (void)sig;
+    checkpointRequested = 1;
+}
+
+#define FNV_OFFSET 14695981039346656037ULL
+
+/* FNV-1a, continued from hash */
+unsigned long long hashBytes(unsigned long long hash, const void* data, size_t length) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+unsigned long long hashFile(const char* path) {
+    unsigned long long hash = FNV_OFFSET;
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return hash;
+    unsigned char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        hash = hashBytes(hash, chunk, n);
+    }
+    fclose(file);
+    return hash;
+}
+
+/* Writes the snapshot next to its final name and renames it, so a crash never leaves half a file */
+int writeCheckpoint(const char* path) {
+    size_t pathLength = strlen(path);
+    char* temporary = (char*)memAlloc(MEM_TEMP, pathLength + 5);
+    memcpy(temporary, path, pathLength);
+    strcpy(temporary + pathLength, ".tmp");
+
+    FILE* file = fopen(temporary, "wb");
+    if (file == NULL) {
+        printf("Error: Could not write checkpoint %s.\n", path);
+        memFree(temporary);
+        return 0;
+    }
+    int version = CHECKPOINT_VERSION;
+    fwrite("LXCP", 1, 4, file);
+    fwrite(&version, sizeof(version), 1, file);
+    fwrite(&scriptHash, sizeof(scriptHash), 1, file);
+    fwrite(&topStatementIndex, sizeof(topStatementIndex), 1, file);
+    fwrite(&statementCount, sizeof(statementCount), 1, file);
+
+    fwrite(&variables.count, sizeof(variables.count), 1, file);
+    for (int i = 0; i < variables.count; i++) {
+        const Variable* var = &variables.vars[i];
+        unsigned char nameLength = (unsigned char)strlen(variables.names[i]);
+        unsigned char type = (unsigned char)var->type;
+        fwrite(&nameLength, 1, 1, file);
+        fwrite(variables.names[i], 1, nameLength, file);
+        fwrite(&type, 1, 1, file);
+        if (var->type == INT) {
+            fwrite(&variables.ints[var->slot], sizeof(int), 1, file);
+        } else {
+            const TextBuffer* text = &variables.texts[var->slot];
+            fwrite(&text->length, sizeof(text->length), 1, file);
+            fwrite(text->data, 1, text->length, file);
+        }
+    }
+
+    fwrite(&loopDepth, sizeof(loopDepth), 1, file);
+    fwrite(loopFrames, sizeof(LoopFrame), loopDepth, file);
+
+    int ok = fclose(file) == 0 && rename(temporary, path) == 0;
+    if (!ok) printf("Error: Could not write checkpoint %s.\n", path);
+    memFree(temporary);
+    return ok;
+}
+
+/* Called before every statement while checkpoints are enabled */
+void checkpointPoint(void) {
+    if (resuming) return;   // Inner loops of the snapshot position are not rebuilt yet
+    if (checkpointRequested || (checkpointEvery > 0 && statementCount >= nextCheckpointAt)) {
+        checkpointRequested = 0;
+        nextCheckpointAt = statementCount + checkpointEvery;
+        fflush(stdout);
+        writeCheckpoint(checkpointPath);
+    }
+}
+
+/* Loads a snapshot written for this script; the run then skips to its position */
+int readCheckpoint(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("Error: Could not open checkpoint %s.\n", path);
+        return 0;
+    }
+
+    char magic[4];
+    int version = 0;
+    unsigned long long hash = 0;
+    int ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, "LXCP", 4) == 0 &&
+             fread(&version, sizeof(version), 1, file) == 1 && version == CHECKPOINT_VERSION &&
+             fread(&hash, sizeof(hash), 1, file) == 1;
+    if (ok && hash != scriptHash) {
+        printf("Error: Checkpoint %s was written for a different code.sta.\n", path);
+        fclose(file);
+        return 0;
+    }
+
+    int count = 0;
+    ok = ok && fread(&resumeTop, sizeof(resumeTop), 1, file) == 1 &&
+         fread(&statementCount, sizeof(statementCount), 1, file) == 1 &&
+         fread(&count, sizeof(count), 1, file) == 1 && count >= 0 && count <= MAX_VAR_COUNT;
+    for (int i = 0; ok && i < count; i++) {
+        char name[32] = "";
+        unsigned char nameLength = 0, type = 0;
+        ok = fread(&nameLength, 1, 1, file) == 1 && nameLength < sizeof(name) &&
+             fread(name, 1, nameLength, file) == nameLength &&
+             fread(&type, 1, 1, file) == 1 && (type == INT || type == TEXT);
+        if (!ok) break;
+        Variable* var = addVariable(&variables, name, (VarType)type);
+        memNote(MEM_VARIABLES, variableSize(var->type));
+        if (var->type == INT) {
+            ok = fread(&variables.ints[var->slot], sizeof(int), 1, file) == 1;
+        } else {
+            TextBuffer* text = &variables.texts[var->slot];
+            size_t length = 0;
+            ok = fread(&length, sizeof(length), 1, file) == 1;
+            if (ok) {
+                textReserve(text, length);
+                ok = fread(text->data, 1, length, file) == length;
+                text->data[ok ? length : 0] = '\0';
+                text->length = ok ? length : 0;
+            }
+        }
+    }
+
+    ok = ok && fread(&resumeDepth, sizeof(resumeDepth), 1, file) == 1 && resumeDepth >= 0;
+    if (ok && resumeDepth > 0) {
+        resumeFrames = (LoopFrame*)memAlloc(MEM_PROGRAM, resumeDepth * sizeof(LoopFrame));
+        ok = fread(resumeFrames, sizeof(LoopFrame), resumeDepth, file) == (size_t)resumeDepth;
+    }
+    fclose(file);
+
+    if (!ok) {
+        printf("Error: Checkpoint %s is damaged.\n", path);
+        return 0;
+    }
+    resuming = 1;
+    return 1;
+}
+
+
+/* Loop JIT: after JIT_HOT_ITERATIONS interpreted iterations, a loop body is compiled
+   to x86-64 code that works directly on the variable slots. Integer assignments, text
+   superinstructions, write, read and newLine are compiled; every other statement is handed back to execute(). */
+#define JIT_HOT_ITERATIONS 16
+
+typedef void (*JitCode)(long firstIteration, long loopCount);
+
+#if JIT_SUPPORTED
+
+/* Output items of a compiled write statement */
+typedef struct {
+    int count;
+    char** texts;           // Literal to print, NULL for a variable item
+    Variable** vars;        // Variable printed for a NULL text
+} JitWrite;
+
+/* Prompt and target of a compiled read statement */
+typedef struct {
+    char* prompt;
+    Variable* var;
+} JitRead;
+
+/* Machine code under construction */
+typedef struct {
+    unsigned char* code;
+    size_t size;
+    size_t capacity;
+    int maxDepth;           // Deepest loop nesting, sizes the stack frame
+    int failed;             // Set when the body cannot be compiled
+} JitBuffer;
+
+/* Compiled loop bodies, keyed by body text */
+typedef struct JitEntry {
+    char* body;
+    JitCode code;           // NULL when compilation failed
+    int varCount;           // Variable count at a failed attempt; retried once it changes
+    struct JitEntry* next;
+} JitEntry;
+
+JitEntry* jitCache = NULL;
+
+/* Runtime helpers called from compiled code */
+void jitTraceIteration(long iteration) {
+    printf("Loop iteration %ld:\n", iteration);
+}
+
+void jitTraceAssigned(Variable* var) {
+    printf("Assigned %d to variable %s\n", variables.ints[var->slot], variableName(var));
+}
+
+void jitBackEdge(void) {
+    LIMIT_BACK_EDGE();
+}
+
+void jitNewLine(void) {
+    printf("\n");
+}
+
+void jitWrite(const JitWrite* write) {
+    for (int i = 0; i < write->count; i++) {
+        if (write->texts[i] != NULL) printf("%s", write->texts[i]);
+        else if (write->vars[i]->type == INT) printf("%d", variables.ints[write->vars[i]->slot]);
+        else printf("%s", variables.texts[write->vars[i]->slot].data);
+    }
+    printf("\n");
+}
+
+void jitFused(const FusedAssignment* fused) {
+    runFusedAssignment(fused, fused->var);
+}
+
+void jitRead(const JitRead* read) {
+    readValue(read->var, read->prompt);
+}
+
+void jitExecute(const char* text) {
+    char* line = memStrdup(MEM_TEMP, text);
+    execute(line);
+    memFree(line);
+}
+
+/* Emitters */
+void jitEmit(JitBuffer* b, const void* bytes, size_t n) {
+    if (b->size + n > b->capacity) {
+        b->capacity = (b->size + n) * 2;
+        b->code = (unsigned char*)memRealloc(MEM_PROGRAM, b->code, b->capacity);
+    }
+    memcpy(b->code + b->size, bytes, n);
+    b->size += n;
+}
+
+void jitEmitU32(JitBuffer* b, unsigned int value) {
+    jitEmit(b, &value, 4);
+}
+
+/* mov reg, imm64 (opcode B8+reg) */
+void jitEmitMovImm(JitBuffer* b, unsigned char opcode, long long value) {
+    unsigned char rex[2] = { 0x48, opcode };
+    jitEmit(b, rex, 2);
+    jitEmit(b, &value, 8);
+}
+
+void jitEmitCall(JitBuffer* b, void* function) {
+    static const unsigned char callRax[] = { 0xFF, 0xD0 };          // call rax
+    jitEmitMovImm(b, 0xB8, (long long)function);
+    jitEmit(b, callRax, sizeof(callRax));
+}
+
+/* <op> [rsp+disp32]: three opcode bytes ending in a ModRM with SIB, then the displacement */
+void jitEmitFrame(JitBuffer* b, unsigned char rex, unsigned char opcode, unsigned char modrm, int disp) {
+    unsigned char op[4] = { rex, opcode, modrm, 0x24 };
+    jitEmit(b, op, 4);
+    jitEmitU32(b, (unsigned int)disp);
+}
+
+void jitEmitExecute(JitBuffer* b, const char* text) {
+    jitEmitMovImm(b, 0xBF, (long long)memStrdup(MEM_PROGRAM, text));                  // mov rdi, text
+    jitEmitCall(b, (void*)jitExecute);
+}
+
+/* Compiles "Identifier(x) Keyword(is) <expr>" for INT targets with the semantics of handleAssignment */
+/* A term of a compiled integer expression */
+typedef struct {
+    int kind;               // 1: add, -1: subtract, 0: divide
+    long long value;        // Constant or divisor
+    Variable* operand;      // Variable added or subtracted, NULL for a constant
+} JitTerm;
+
+int jitCompileIntAssignment(JitBuffer* b, const char* text) {
+    char varName[32];
+    int expressionStart = -1;
+    sscanf(text, "Identifier(%31[^)]) Keyword(is) %n", varName, &expressionStart);
+    if (expressionStart < 0) return 0;
+
+    Variable* target = getVariable(varName);
+    if (target == NULL || target->type != INT) return 0;
+
+    /* Validate the whole expression before emitting anything */
+    JitTerm* terms = (JitTerm*)memAlloc(MEM_TEMP, (strlen(text) / 2 + 1) * sizeof(JitTerm));
+    int termCount = 0;
+    int lastOperation = 1;
+    char* exprCopy = memStrdup(MEM_TEMP, text + expressionStart);
+    char* token = strtok(exprCopy, " ");
+    int ok = 1;
+    while (token != NULL && ok) {
+        if (strncmp(token, "IntConst(", 9) == 0) {
+            int num = 0;
+            sscanf(token, "IntConst(%d)", &num);
+            terms[termCount].kind = lastOperation;
+            terms[termCount].value = num;
+            terms[termCount++].operand = NULL;
+        } else if (strncmp(token, "Identifier(", 11) == 0) {
+            char otherVarName[32];
+            sscanf(token, "Identifier(%31[^)])", otherVarName);
+            Variable* other = getVariable(otherVarName);
+            if (other == NULL || other->type != INT) {
+                ok = 0;
+            } else {
+                terms[termCount].kind = lastOperation;
+                terms[termCount++].operand = other;
+            }
+        } else if (strcmp(token, "Operator(/)") == 0) {
+            int divisor = 0;
+            token = strtok(NULL, " ");
+            if (token == NULL || sscanf(token, "IntConst(%d)", &divisor) != 1 || divisor == 0) {
+                ok = 0;
+            } else {
+                terms[termCount].kind = 0;
+                terms[termCount].value = divisor;
+                terms[termCount++].operand = NULL;
+            }
+        } else if (strcmp(token, "Operator(+)") == 0) {
+            lastOperation = 1;
+        } else if (strcmp(token, "Operator(-)") == 0) {
+            lastOperation = -1;
+        } else {
+            ok = 0;
+        }
+        token = strtok(NULL, " ");
+    }
+    memFree(exprCopy);
+    if (!ok) {
+        memFree(terms);
+        return 0;
+    }
+
+    static const unsigned char xorEax[] = { 0x31, 0xC0 };              // xor eax, eax
+    static const unsigned char loadRdx[] = { 0x48, 0x63, 0x11 };        // movsxd rdx, dword [rcx]
+    static const unsigned char addRdx[] = { 0x48, 0x01, 0xD0 };         // add rax, rdx
+    static const unsigned char subRdx[] = { 0x48, 0x29, 0xD0 };         // sub rax, rdx
+    static const unsigned char divRcx[] = { 0x48, 0x99, 0x48, 0xF7, 0xF9 };  // cqo; idiv rcx
+    static const unsigned char clampLow[] = { 0x31, 0xD2, 0x48, 0x39, 0xD0, 0x48, 0x0F, 0x4C, 0xC2 };  // xor edx, edx; cmp rax, rdx; cmovl rax, rdx
+    static const unsigned char clampHigh[] = { 0x48, 0x39, 0xD0, 0x48, 0x0F, 0x4F, 0xC2 };             // cmp rax, rdx; cmovg rax, rdx
+    static const unsigned char storeEax[] = { 0x89, 0x01 };             // mov dword [rcx], eax
+
+    jitEmit(b, xorEax, sizeof(xorEax));
+    for (int i = 0; i < termCount; i++) {
+        if (terms[i].kind == 0) {
+            jitEmitMovImm(b, 0xB9, terms[i].value);                     // mov rcx, divisor
+            jitEmit(b, divRcx, sizeof(divRcx));
+            continue;
+        }
+        if (terms[i].operand != NULL) {
+            jitEmitMovImm(b, 0xB9, (long long)&variables.ints[terms[i].operand->slot]);  // mov rcx, &slot
+            jitEmit(b, loadRdx, sizeof(loadRdx));
+        } else {
+            jitEmitMovImm(b, 0xBA, terms[i].value);                     // mov rdx, constant
+        }
+        jitEmit(b, terms[i].kind > 0 ? addRdx : subRdx, 3);
+    }
+    memFree(terms);
+
+    // Saturate to 0..MAX_INT and store
+    jitEmit(b, clampLow, sizeof(clampLow));
+    jitEmitMovImm(b, 0xBA, MAX_INT);
+    jitEmit(b, clampHigh, sizeof(clampHigh));
+    jitEmitMovImm(b, 0xB9, (long long)&variables.ints[target->slot]);
+    jitEmit(b, storeEax, sizeof(storeEax));
+
+    if (!quietMode) {
+        jitEmitMovImm(b, 0xBF, (long long)target);                      // mov rdi, target
+        jitEmitCall(b, (void*)jitTraceAssigned);
+    }
+    return 1;
+}
+
+/* Compiles a write statement with the token rules of handleIO */
+int jitCompileWrite(JitBuffer* b, const char* text) {
+    JitWrite* write = (JitWrite*)memCalloc(MEM_PROGRAM, 1, sizeof(JitWrite));
+    size_t maxItems = strlen(text) / 2 + 1;
+    write->texts = (char**)memCalloc(MEM_PROGRAM, maxItems, sizeof(char*));
+    write->vars = (Variable**)memCalloc(MEM_PROGRAM, maxItems, sizeof(Variable*));
+
+    char* line = memStrdup(MEM_TEMP, text + 14);
+    char* token = strtok(line, " ,.");
+    int ok = 1;
+    while (token != NULL && ok) {
+        if (strncmp(token, "String(", 7) == 0) {
+            char str[MAX_STR_LEN];
+            if (sscanf(token, "String(\"%255[^\"])\"", str) == 1) {
+                write->texts[write->count++] = memStrdup(MEM_PROGRAM, str);
+            } else {
+                write->texts[write->count++] = memStrdup(MEM_PROGRAM, " ");
+            }
+        } else if (strncmp(token, "Identifier(", 11) == 0) {
+            char varName[32];
+            sscanf(token, "Identifier(%31[^)])", varName);
+            Variable* var = getVariable(varName);
+            if (var == NULL) ok = 0;        // Let the interpreter report it
+            else write->vars[write->count++] = var;
+        }
+        token = strtok(NULL, " ,.");
+    }
+    memFree(line);
+
+    if (!ok) {
+        for (int i = 0; i < write->count; i++) memFree(write->texts[i]);
+        memFree(write->texts);
+        memFree(write->vars);
+        memFree(write);
+        return 0;
+    }
+    jitEmitMovImm(b, 0xBF, (long long)write);                           // mov rdi, write
+    jitEmitCall(b, (void*)jitWrite);
+    return 1;
+}
+
+/* Counts a compiled statement for --stats and --max-statements */
+void jitEmitStatementCount(JitBuffer* b) {
+    static const unsigned char incCounter[] = { 0x48, 0xFF, 0x01 };    // inc qword [rcx]
+    if (!statsEnabled && !limitsEnabled) return;
+    jitEmitMovImm(b, 0xB9, (long long)&statementCount);
+    jitEmit(b, incCounter, sizeof(incCounter));
+}
+
+/* Compiles a read statement with the token rules of handleIO */
+int jitCompileRead(JitBuffer* b, const char* text) {
+    char prompt[MAX_STR_LEN] = "", varName[32];
+    const char* target = text + 13;
+    while (*target == ' ') target++;
+    if (strncmp(target, "String(", 7) == 0) {
+        sscanf(target, "String(\"%255[^\"]\")", prompt);
+        target = strstr(target, "Identifier(");
+    }
+    if (target == NULL || sscanf(target, "Identifier(%31[^)])", varName) != 1) return 0;
+    Variable* var = getVariable(varName);
+    if (var == NULL) return 0;          // Let the interpreter report it
+
+    JitRead* read = (JitRead*)memAlloc(MEM_PROGRAM, sizeof(JitRead));
+    read->prompt = memStrdup(MEM_PROGRAM, prompt);
+    read->var = var;
+    jitEmitMovImm(b, 0xBF, (long long)read);                            // mov rdi, read
+    jitEmitCall(b, (void*)jitRead);
+    return 1;
+}
+
+/* Text superinstructions become a direct call on the resolved variable */
+int jitCompileFused(JitBuffer* b, const char* text) {
+    FusedAssignment fused;
+    if (!parseFusedAssignment(text, &fused) || fused.kind == FUSED_INT_ADD) return 0;
+    fused.var = getVariable(fused.varName);
+    if (fused.var == NULL || fused.var->type != TEXT) return 0;
+
+    FusedAssignment* op = (FusedAssignment*)memAlloc(MEM_PROGRAM, sizeof(FusedAssignment));
+    *op = fused;
+    jitEmitMovImm(b, 0xBF, (long long)op);                              // mov rdi, op
+    jitEmitCall(b, (void*)jitFused);
+    return 1;
+}
+
+void jitCompileStmt(JitBuffer* b, const char* text) {
+    if (strncmp(text, "Keyword(write)", 14) == 0) {
+        if (!jitCompileWrite(b, text)) {
+            jitEmitExecute(b, text);
+            return;
+        }
+    } else if (strncmp(text, "Keyword(newLine)", 16) == 0) {
+        jitEmitCall(b, (void*)jitNewLine);
+    } else if (strncmp(text, "Keyword(read)", 13) == 0) {
+        if (!jitCompileRead(b, text)) {
+            jitEmitExecute(b, text);
+            return;
+        }
+    } else if (!jitCompileFused(b, text) && !jitCompileIntAssignment(b, text)) {
+        jitEmitExecute(b, text);
+        return;                                     // execute() counts it
+    }
+    jitEmitStatementCount(b);
+}
+
+/* Emits a counted loop; the outermost one takes its bounds from the function arguments */
+void jitCompileLoop(JitBuffer* b, const char* loopBody, int depth, const char* countToken) {
+    int indexSlot = depth * 16;
+    int limitSlot = depth * 16 + 8;
+    if (depth > b->maxDepth) b->maxDepth = depth;
+
+    if (countToken != NULL) {
+        int count = 0;
+        char varName[32];
+        if (sscanf(countToken, "IntConst(%d)", &count) == 1) {
+            jitEmitMovImm(b, 0xB8, count);                              // mov rax, count
+        } else if (sscanf(countToken, "Identifier(%31[^)])", varName) == 1 &&
+                   getVariable(varName) != NULL && getVariable(varName)->type == INT) {
+            static const unsigned char loadRax[] = { 0x48, 0x63, 0x01 };    // movsxd rax, dword [rcx]
+            jitEmitMovImm(b, 0xB9, (long long)&variables.ints[getVariable(varName)->slot]);
+            jitEmit(b, loadRax, sizeof(loadRax));
+        } else {
+            b->failed = 1;
+            return;
+        }
+        jitEmitFrame(b, 0x48, 0x89, 0x84, limitSlot);                   // mov [rsp+limit], rax
+        jitEmitFrame(b, 0x48, 0xC7, 0x84, indexSlot);                   // mov qword [rsp+index], 0
+        jitEmitU32(b, 0);
+        jitEmitStatementCount(b);
+    }
+
+    size_t top = b->size;
+    static const unsigned char jge[] = { 0x0F, 0x8D };
+    jitEmitFrame(b, 0x48, 0x8B, 0x84, indexSlot);                       // mov rax, [rsp+index]
+    jitEmitFrame(b, 0x48, 0x3B, 0x84, limitSlot);                       // cmp rax, [rsp+limit]
+    jitEmit(b, jge, sizeof(jge));
+    size_t exitPatch = b->size;
+    jitEmitU32(b, 0);
+
+    if (!quietMode) {
+        static const unsigned char iterationArg[] = { 0x48, 0x89, 0xC7, 0x48, 0x83, 0xC7, 0x01 };  // mov rdi, rax; add rdi, 1
+        jitEmit(b, iterationArg, sizeof(iterationArg));
+        jitEmitCall(b, (void*)jitTraceIteration);
+    }
+    if (limitsEnabled) jitEmitCall(b, (void*)jitBackEdge);
+
+    LoopBody body;
+    splitLoopBody(loopBody, NULL, &body);
+    for (int i = 0; i < body.count && !b->failed; i++) {
+        if (body.stmts[i].text == NULL) {
+            jitCompileLoop(b, body.stmts[i].body, depth + 1, body.stmts[i].countToken);
+        } else {
+            jitCompileStmt(b, body.stmts[i].text);
+        }
+    }
+    freeLoopBody(&body);
+
+    static const unsigned char jmp = 0xE9;
+    jitEmitFrame(b, 0x48, 0xFF, 0x84, indexSlot);                       // inc qword [rsp+index]
+    jitEmit(b, &jmp, 1);
+    jitEmitU32(b, (unsigned int)(top - (b->size + 4)));
+    unsigned int exitOffset = (unsigned int)(b->size - (exitPatch + 4));
+    memcpy(b->code + exitPatch, &exitOffset, 4);
+}
+
+JitCode jitCompile(const char* loopBody) {
+    static const unsigned char prologue[] = { 0x55, 0x48, 0x89, 0xE5, 0x48, 0x81, 0xEC };  // push rbp; mov rbp, rsp; sub rsp, imm32
+    static const unsigned char epilogue[] = { 0xC9, 0xC3 };                                // leave; ret
+    JitBuffer b = {0};
+
+    jitEmit(&b, prologue, sizeof(prologue));
+    size_t framePatch = b.size;
+    jitEmitU32(&b, 0);
+    jitEmitFrame(&b, 0x48, 0x89, 0xBC, 0);                              // mov [rsp], rdi
+    jitEmitFrame(&b, 0x48, 0x89, 0xB4, 8);                              // mov [rsp+8], rsi
+    jitCompileLoop(&b, loopBody, 0, NULL);
+    jitEmit(&b, epilogue, sizeof(epilogue));
+
+    if (b.failed) {
+        memFree(b.code);
+        return NULL;
+    }
+    unsigned int frameSize = (b.maxDepth + 1) * 16;
+    memcpy(b.code + framePatch, &frameSize, 4);
+
+    void* memory = mmap(NULL, b.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        memFree(b.code);
+        return NULL;
+    }
+    memcpy(memory, b.code, b.size);
+    memFree(b.code);
+    if (mprotect(memory, b.size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, b.size);
+        return NULL;
+    }
+    memAccount(MEM_PROGRAM, b.size);                                    // The mapping stays for the whole run
+    return (JitCode)memory;
+}
+
+JitCode jitLookup(const char* loopBody) {
+    JitEntry* entry = jitCache;
+    while (entry != NULL && strcmp(entry->body, loopBody) != 0) entry = entry->next;
+
+    if (entry == NULL) {
+        entry = (JitEntry*)memCalloc(MEM_PROGRAM, 1, sizeof(JitEntry));
+        entry->body = memStrdup(MEM_PROGRAM, loopBody);
+        entry->next = jitCache;
+        jitCache = entry;
+    } else if (entry->code != NULL || entry->varCount == variables.count) {
+        return entry->code;
+    }
+    entry->code = jitCompile(loopBody);
+    entry->varCount = variables.count;
+    return entry->code;
+}
+
+#else
+
+JitCode jitLookup(const char* loopBody) {
+    (void)loopBody;
+    return NULL;
+}
+
+#endif
+
+/* Output replication: a loop body made only of write, newLine and loops of the same kind
+   cannot change any variable, so every iteration prints the same text. That text is
+   rendered once and copied with memcpy instead of running the statements again. */
+#define REPLICATE_LIMIT (1 << 24)   // Largest nested loop output rendered in memory
+#define REPLICATE_CHUNK (1 << 16)   // Output is handed to stdout in blocks of about this size
+
+/* Appends count copies of text; each memcpy doubles the copied part */
+void bufferRepeat(TextBuffer* out, const char* text, size_t length, long long count) {
+    if (count <= 0 || length == 0) return;
+    size_t start = out->length;
+    size_t total = length * count;
+    bufferReserve(out, start + total);
+    memcpy(out->data + start, text, length);
+    for (size_t done = length; done < total; ) {
+        size_t n = done < total - done ? done : total - done;
+        memcpy(out->data + start + done, out->data + start, n);
+        done += n;
+    }
+    out->length = start + total;
+    out->data[out->length] = '\0';
+}
+
+/* Renders iterations first+1 .. first+count of a body whose single iteration prints once */
+int renderIterations(TextBuffer* out, const TextBuffer* once, long long first, long long count) {
+    if (quietMode) {
+        if (out->length + once->length * count > REPLICATE_LIMIT) return 0;
+        bufferRepeat(out, once->data, once->length, count);
+        return 1;
+    }
+    for (long long i = first; i < first + count; i++) {
+        char trace[40];
+        bufferAppend(out, trace, snprintf(trace, sizeof(trace), "Loop iteration %lld:\n", i + 1));
+        bufferAppend(out, once->data, once->length);
+        if (out->length > REPLICATE_LIMIT) return 0;
+    }
+    return 1;
+}
+
+/* Renders one iteration of body into out and counts its statements; 0 if it is not pure output */
+int renderPureBody(const LoopBody* body, TextBuffer* out, long long* statements) {
+    for (int k = 0; k < body->count; k++) {
+        const LoopStmt* stmt = &body->stmts[k];
+        if (stmt->text == NULL) {
+            int count = 0;
+            char varName[32];
+            Variable* var = NULL;
+            if (sscanf(stmt->countToken, "IntConst(%d)", &count) != 1) {
+                if (sscanf(stmt->countToken, "Identifier(%31[^)])", varName) != 1 ||
+                    (var = getVariable(varName)) == NULL || var->type != INT) return 0;
+                count = variables.ints[var->slot];
+            }
+
+            LoopBody inner;
+            TextBuffer once = { NULL, 0, 0 };
+            long long innerStatements = 0;
+            bufferAppend(&once, "", 0);
+            splitLoopBody(stmt->body, &stmt->bodyMap, &inner);
+            int pure = renderPureBody(&inner, &once, &innerStatements) &&
+                       renderIterations(out, &once, 0, count > 0 ? count : 0);
+            freeLoopBody(&inner);
+            memFree(once.data);
+            if (!pure) return 0;
+            *statements += 1 + (count > 0 ? count : 0) * innerStatements;
+        } else if (strncmp(stmt->text, "Keyword(write)", 14) == 0) {
+            char* line = memStrdup(MEM_TEMP, stmt->text + 14);
+            renderWrite(line, out);
+            memFree(line);
+            (*statements)++;
+        } else if (strncmp(stmt->text, "Keyword(newLine)", 16) == 0) {
+            bufferAppend(out, "\n", 1);
+            (*statements)++;
+        } else {
+            return 0;
+        }
+        if (out->length > REPLICATE_LIMIT) return 0;
+    }
+    return 1;
+}
+
+/* Runs a loop with a pure output body by copying its output; returns 0 if it cannot */
+int replicateLoop(int loopCount, const LoopBody* body) {
+    if (profileEnabled) return 0;
+    for (int k = 0; k < body->count; k++) {
+        const char* text = body->stmts[k].text;
+        if (text != NULL && strncmp(text, "Keyword(write)", 14) != 0 && strncmp(text, "Keyword(newLine)", 16) != 0) {
+            return 0;
+        }
+    }
+
+    TextBuffer once = { NULL, 0, 0 };
+    long long statements = 0;
+    bufferAppend(&once, "", 0);
+    if (!renderPureBody(body, &once, &statements)) {
+        memFree(once.data);
+        return 0;
+    }
+    if (loopCount > 0 && statements * loopCount > statementLimit - statementCount) {
+        memFree(once.data);
+        return 0;                   // Run it normally so it stops at the limit
+    }
+
+    // Gather iterations into blocks so large outputs go out in few fwrite calls
+    TextBuffer chunk = { NULL, 0, 0 };
+    size_t perIteration = once.length + (quietMode ? 0 : 32);
+    long long batch = (long long)(REPLICATE_CHUNK / (perIteration > 0 ? perIteration : 1)) + 1;
+    for (long long i = 0; i < loopCount && perIteration > 0; i += batch) {
+        long long count = loopCount - i < batch ? loopCount - i : batch;
+        bufferClear(&chunk);
+        renderIterations(&chunk, &once, i, count);
+        fwrite(chunk.data, 1, chunk.length, stdout);
+        if (limitsEnabled) checkLimits();
+    }
+    if (loopCount > 0) statementCount += statements * loopCount;
+
+    memFree(chunk.data);
+    memFree(once.data);
+    return 1;
+}
+
+void handleLoop(int loopCount, const char* loopBody, const SourceMap* map) {
+    LoopBody body;
+    splitLoopBody(loopBody, map, &body);
+
+    // A restored loop continues at its saved iteration and statement, with its saved count
+    int first = 0, firstStmt = 0, resumed = 0;
+    if (resuming && loopDepth < resumeDepth) {
+        const LoopFrame* saved = &resumeFrames[loopDepth];
+        loopCount = saved->count;
+        first = saved->iteration;
+        firstStmt = saved->stmt;
+        resumed = 1;
+        if (loopDepth + 1 == resumeDepth) resuming = 0;
+    } else {
+        statementCount++;
+        if (replicateLoop(loopCount, &body)) {
+            freeLoopBody(&body);
+            return;
+        }
+    }
+    int depth = pushLoopFrame(loopCount);
+
+    for (int i = first; i < loopCount; i++) {
+        LIMIT_BACK_EDGE();
+
+        // Hot loop: the compiled body runs the remaining iterations
+        if (jitEnabled && i == JIT_HOT_ITERATIONS) {
+            JitCode code = jitLookup(loopBody);
+            if (code != NULL) {
+                code(i, loopCount);
+                break;
+            }
+        }
+
+        // The trace of a restored iteration was printed before the snapshot
+        int resumedIteration = resumed && i == first;
+        if (!quietMode && !resumedIteration) printf("Loop iteration %d:\n", i + 1);
+        for (int k = resumedIteration ? firstStmt : 0; k < body.count; k++) {
+            loopFrames[depth].iteration = i;
+            loopFrames[depth].stmt = k;
+            if (checkpointEnabled) checkpointPoint();
+            runLoopStmt(&body.stmts[k]);
+        }
+    }
+
+    loopDepth--;
+    freeLoopBody(&body);
+}
+
+void handleIsStatement(const char* line) {
+    char varName[32];
+    int expressionStart = -1;
+    sscanf(line, " Identifier(%31[^)]) Operator(is) %n", varName, &expressionStart);
+    if (expressionStart < 0) {
+        printf("Error: Invalid assignment.\n");
+        return;
+    }
+    handleAssignment(varName, line + expressionStart);
+}
+
+
+void execute(const char* line) {
+    statementCount++;
+
+    if (strncmp(line, "Keyword(write)", 14) == 0) {
+        handleIO("Keyword(write)", line + 14);
+    } else if (strncmp(line, "Keyword(int)", 12) == 0) {
+        handleDeclaration(line);
+    } else if (strncmp(line, "Keyword(text)", 13) == 0) {
+        handleDeclaration(line);
+    } else if (strncmp(line, "Keyword(read)", 13) == 0) {
+        const char* rest = line + 13;
+        while (isspace((unsigned char)*rest)) rest++;
+        handleIO("Keyword(read)", rest);
+    } else if (strncmp(line, "Keyword(newLine)", 16) == 0) {
+        handleIO("Keyword(newLine)", NULL);
+    } else if (strncmp(line, "Keyword(loop)", 13) == 0) {
+        handleLoopStatement(line, NULL);
+    } else if (strncmp(line, "Keyword(is)", 11) == 0) {
+        handleIsStatement(line + 11);
+    } else if (strstr(line, "Keyword(is)") != NULL) {
+        FusedAssignment fused;
+        if (parseFusedAssignment(line, &fused) && runFusedAssignment(&fused, getVariable(fused.varName))) {
+            return;
+        }
+        char varName[32];
+        int expressionStart = -1;
+        sscanf(line, "Identifier(%31[^)]) Keyword(is) %n", varName, &expressionStart);
+        if (expressionStart < 0) {
+            printf("Error: Invalid assignment.\n");
+            return;
+        }
+        handleAssignment(varName, line + expressionStart);
+    } else {
+        printf("Error: Unrecognized keyword.\n");
+    }
+}
+
+
+
+/* Removes every comment from line in one pass; a "/" left before a removed comment and a "*"
+   after it form a new comment start, as if the line were searched again from the beginning */
+void removeComments(char* line) {
+    char* out = line;
+    const char* in = line;
+    while (*in != '\0') {
+        const char* bodyStart = NULL;
+        if (in[0] == '/' && in[1] == '*') {
+            bodyStart = in + 2;
+        } else if (in[0] == '*' && out > line && out[-1] == '/') {
+            out--;
+            bodyStart = in + 1;
+        }
+        if (bodyStart == NULL) {
+            *out++ = *in++;
+            continue;
+        }
+        const char* end = strstr(bodyStart, "*/");
+        if (end == NULL) break;
+        in = end + 2;
+    }
+    *out = '\0';
+}
+
+/* Runs a top-level statement; its map gives the source position of every token */
+void executeStatement(const char* line, const SourceMap* map) {
+    if (resuming) {
+        // Statements before the snapshot position already ran; their effects are restored
+        if (topStatementIndex < resumeTop) {
+            topStatementIndex++;
+            return;
+        }
+        if (resumeDepth == 0) resuming = 0;
+    }
+    if (checkpointEnabled) checkpointPoint();
+    if (limitsEnabled) checkLimits();
+
+    if (strncmp(line, "Keyword(loop)", 13) == 0) {
+        handleLoopStatement(line, map);
+    } else if (!profileEnabled) {
+        execute(line);
+    } else {
+        int srcLine, srcColumn;
+        findTokenPos(map, 0, &srcLine, &srcColumn);
+        ProfileNode* node = profileEnter(srcLine, srcColumn, line);
+        long long start = profileNow();
+        execute(line);
+        profileLeave(node, start);
+    }
+    topStatementIndex++;
+}
+
+/* Constant folding: while statements are loaded, values that follow from literals alone are
+   tracked and assignments whose operands are all known become a single constant. Loop counts
+   naming a known variable become IntConst. A loop first forgets everything its body assigns,
+   and forgets it again afterwards; read targets are never known. Evaluation goes through
+   evaluateInt and evaluateText, so saturation and text subtraction match the run exactly. */
+typedef enum { VALUE_UNKNOWN, VALUE_KNOWN, VALUE_UNTRUSTED } KnownState;
+
+VariableStore knownStore;                   // Names, types and, when known, the values
+KnownState knownStates[MAX_VAR_COUNT];      // UNTRUSTED: declared in a loop or malformed, never folded
+int foldEnabled = 1;        // --no-fold turns the pass off
+
+/* A token of the statement being folded */
+typedef struct {
+    const char* text;
+    size_t length;
+    int line;
+    int column;
+} FoldToken;
+
+/* Rewritten statement; tokens before next are already copied */
+typedef struct {
+    const FoldToken* tokens;
+    int next;
+    TextBuffer line;
+    SourceMap map;
+    int changed;
+} FoldOutput;
+
+KnownState* knownState(const Variable* known) {
+    return &knownStates[known - knownStore.vars];
+}
+
+Variable* knownLookup(const char* name) {
+    Variable* known = findVariable(&knownStore, name);
+    return known != NULL && *knownState(known) == VALUE_KNOWN ? known : NULL;
+}
+
+/* Like declareVariable and the implicit declaration of handleAssignment, a name keeps its first entry */
+Variable* addKnown(const char* name, VarType type, KnownState state) {
+    Variable* known = findVariable(&knownStore, name);
+    if (known != NULL) return known;
+    known = addVariable(&knownStore, name, type);
+    if (known != NULL) *knownState(known) = state;
+    return known;
+}
+
+/* Token texts point into the whole statement, so they are not scanned with sscanf: it would
+   measure the rest of the statement on every call */
+int tokenName(const FoldToken* token, char* name) {
+    if (token->length <= 11 || strncmp(token->text, "Identifier(", 11) != 0) return 0;
+    const char* start = token->text + 11;
+    const char* end = (const char*)memchr(start, ')', token->length - 11);
+    size_t length = end != NULL ? (size_t)(end - start) : token->length - 11;
+    if (length == 0) return 0;
+    if (length > 31) length = 31;
+    memcpy(name, start, length);
+    name[length] = '\0';
+    return 1;
+}
+
+/* The variable is no longer known; a name first seen here cannot be trusted at all */
+void forgetKnown(const char* name) {
+    Variable* known = findVariable(&knownStore, name);
+    if (known == NULL) {
+        addKnown(name, INT, VALUE_UNTRUSTED);
+    } else if (*knownState(known) == VALUE_KNOWN) {
+        *knownState(known) = VALUE_UNKNOWN;
+    }
+}
+
+void forgetIdentifiers(const FoldToken* tokens, int start, int end) {
+    char name[32];
+    for (int i = start; i < end; i++) {
+        if (tokenName(&tokens[i], name)) forgetKnown(name);
+    }
+}
+
+int foldTokenIs(const FoldToken* token, const char* expected) {
+    return tokenIs(token->text, token->length, expected);
+}
+
+/* Copies the unchanged tokens before index */
+void foldCopy(FoldOutput* out, int index) {
+    for (; out->next < index; out->next++) {
+        const FoldToken* token = &out->tokens[out->next];
+        if (out->line.length > 0) bufferAppend(&out->line, " ", 1);
+        addTokenPos(&out->map, out->line.length, token->line, token->column);
+        bufferAppend(&out->line, token->text, token->length);
+    }
+}
+
+/* Replaces tokens [start, end) with one token at the position of the first */
+void foldReplace(FoldOutput* out, int start, int end, const char* text) {
+    foldCopy(out, start);
+    if (out->line.length > 0) bufferAppend(&out->line, " ", 1);
+    addTokenPos(&out->map, out->line.length, out->tokens[start].line, out->tokens[start].column);
+    bufferAppend(&out->line, text, strlen(text));
+    out->next = end;
+    out->changed = 1;
+}
+
+/* A folded text can be written back as String("...") only if handleAssignment reads it unchanged.
+   It must be no longer than a literal the lexer accepts: evaluateText rebuilds literals that
+   contain spaces in a MAX_STR_LEN buffer. */
+int textLiteralFits(const char* text, size_t length) {
+    if (length > MAX_STRING_SIZE - 3) return 0;
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] == '"' || text[i] == ')' || text[i] == '\n' || (text[i] == ' ' && text[i + 1] == ' ')) return 0;
+    }
+    return 1;
+}
+
+/* Literal of a declaration, known only if handleDeclaration reads it back whole */
+int declarationLiteral(const FoldToken* token, const Variable* known) {
+    if (known->type == INT) {
+        char literal[32];
+        if (token->length >= sizeof(literal)) return 0;
+        memcpy(literal, token->text, token->length);
+        literal[token->length] = '\0';
+        return sscanf(literal, "IntConst(%d)", &knownStore.ints[known->slot]) == 1;
+    }
+    if (token->length < 10 || strncmp(token->text, "String(\"", 8) != 0) return 0;
+    const char* start = token->text + 8;
+    size_t length = token->length - 10;
+    if (length == 0 || length >= MAX_STR_LEN || strncmp(start + length, "\")", 2) != 0) return 0;
+    for (size_t i = 0; i < length; i++) {
+        if (start[i] == ' ' || start[i] == ',' || start[i] == '.' || start[i] == '"') return 0;
+    }
+    textSet(&knownStore.texts[known->slot], start, length);
+    return 1;
+}
+
+/* Follows handleDeclaration; anything it would reject makes the rest of the names untrusted */
+void foldDeclaration(const FoldToken* tokens, int start, int end, int inLoop) {
+    VarType type = foldTokenIs(&tokens[start], "Keyword(int)") ? INT : TEXT;
+    char name[32];
+    int i = start + 1;
+    while (i < end && tokenName(&tokens[i], name)) {
+        Variable* known = findVariable(&knownStore, name);
+        int fresh = known == NULL;
+        if (fresh) known = addKnown(name, type, inLoop ? VALUE_UNTRUSTED : VALUE_KNOWN);
+        i++;
+        if (i < end && foldTokenIs(&tokens[i], "Keyword(is)")) {
+            i++;
+            if (i >= end) break;
+            if (fresh && known != NULL && *knownState(known) == VALUE_KNOWN && !declarationLiteral(&tokens[i], known)) {
+                *knownState(known) = VALUE_UNTRUSTED;
+                break;
+            }
+            i++;
+        }
+        if (i >= end || !foldTokenIs(&tokens[i], "Comma")) break;
+        i++;
+    }
+    forgetIdentifiers(tokens, i, end);
+}
+
+/* Joins tokens [start, end) with blanks, the way statements are assembled */
+char* joinTokens(const FoldToken* tokens, int start, int end) {
+    TextBuffer text = { NULL, 0, 0 };
+    bufferAppend(&text, "", 0);
+    for (int i = start; i < end; i++) {
+        if (i > start) bufferAppend(&text, " ", 1);
+        bufferAppend(&text, tokens[i].text, tokens[i].length);
+    }
+    return text.data;
+}
+
+void foldAssignment(FoldOutput* out, int start, int end) {
+    const FoldToken* tokens = out->tokens;
+    char name[32];
+    tokenName(&tokens[start], name);
+    char* expression = joinTokens(tokens, start + 2, end);
+    Variable* known = findVariable(&knownStore, name);
+    if (known == NULL) {
+        known = addKnown(name, strstr(expression, "String(") != NULL ? TEXT : INT, VALUE_UNKNOWN);
+    }
+    if (known == NULL || *knownState(known) == VALUE_UNTRUSTED) {
+        memFree(expression);
+        return;
+    }
+
+    char literal[MAX_STR_LEN + 16] = "";
+    int foldable = 0;
+    if (known->type == INT) {
+        int value;
+        foldable = evaluateInt(expression, &knownStore, knownLookup, 0, &value);
+        if (foldable) {
+            knownStore.ints[known->slot] = value;
+            snprintf(literal, sizeof(literal), "IntConst(%d)", value);
+        }
+    } else {
+        TextBuffer result = { NULL, 0, 0 };
+        foldable = evaluateText(expression, &knownStore, knownLookup, 0, &result);
+        if (foldable) {
+            textSet(&knownStore.texts[known->slot], result.data, result.length);
+            if (textLiteralFits(result.data, result.length)) {
+                snprintf(literal, sizeof(literal), "String(\"%s\")", result.data);
+            }
+        }
+        memFree(result.data);
+    }
+    *knownState(known) = foldable ? VALUE_KNOWN : VALUE_UNKNOWN;
+    if (foldable && literal[0] != '\0' && strcmp(expression, literal) != 0) {
+        foldReplace(out, start + 2, end, literal);
+    }
+    memFree(expression);
+}
+
+/* Finds the end of the loop starting at tokens[start], the way splitLoopBody does;
+   bodyStart/bodyEnd bound its body without the braces. Returns -1 if it is malformed. */
+int foldLoopEnd(const FoldToken* tokens, int start, int end, int* bodyStart, int* bodyEnd) {
+    if (start + 2 >= end || !foldTokenIs(&tokens[start + 2], "Keyword(times)")) return -1;
+    int i = start + 3;
+    int depth = 0;
+    if (i < end && foldTokenIs(&tokens[i], "LeftCurlyBracket")) {
+        *bodyStart = i + 1;
+        for (depth = 1, i++; i < end; i++) {
+            if (foldTokenIs(&tokens[i], "LeftCurlyBracket")) {
+                depth++;
+            } else if (foldTokenIs(&tokens[i], "RightCurlyBracket") && --depth == 0) {
+                *bodyEnd = i;
+                return i + 1;
+            }
+        }
+        return -1;
+    }
+    *bodyStart = i;
+    for (; i < end; i++) {
+        if (foldTokenIs(&tokens[i], "LeftCurlyBracket")) {
+            depth++;
+        } else if (foldTokenIs(&tokens[i], "RightCurlyBracket")) {
+            if (--depth == 0) break;
+        } else if (depth == 0 && foldTokenIs(&tokens[i], "EndOfLine")) {
+            break;
+        }
+    }
+    *bodyEnd = i < end ? i + 1 : end;
+    return *bodyEnd;
+}
+
+void foldStatements(FoldOutput* out, int start, int end, int inLoop);
+
+/* Forgets every variable the statements in [start, end) may assign */
+void forgetAssigned(const FoldToken* tokens, int start, int end) {
+    char name[32];
+    int i = start;
+    while (i < end) {
+        if (foldTokenIs(&tokens[i], "EndOfLine") || foldTokenIs(&tokens[i], "LeftCurlyBracket") ||
+            foldTokenIs(&tokens[i], "RightCurlyBracket")) {
+            i++;
+            continue;
+        }
+        // Braces end a piece too, so a statement after a nested loop is seen on its own
+        int stmtEnd = i;
+        while (stmtEnd < end && !foldTokenIs(&tokens[stmtEnd], "EndOfLine") &&
+               !foldTokenIs(&tokens[stmtEnd], "LeftCurlyBracket") && !foldTokenIs(&tokens[stmtEnd], "RightCurlyBracket")) {
+            stmtEnd++;
+        }
+        if (foldTokenIs(&tokens[i], "Keyword(write)") || foldTokenIs(&tokens[i], "Keyword(newLine)")) {
+            // Output only
+        } else if (tokenName(&tokens[i], name) && i + 1 < stmtEnd && foldTokenIs(&tokens[i + 1], "Keyword(is)")) {
+            forgetKnown(name);
+        } else {
+            forgetIdentifiers(tokens, i, stmtEnd);
+        }
+        i = stmtEnd;
+    }
+}
+
+void foldStatement(FoldOutput* out, int start, int end, int inLoop) {
+    const FoldToken* tokens = out->tokens;
+    char name[32];
+    if (foldTokenIs(&tokens[start], "Keyword(write)") || foldTokenIs(&tokens[start], "Keyword(newLine)")) {
+        return;
+    } else if (foldTokenIs(&tokens[start], "Keyword(int)") || foldTokenIs(&tokens[start], "Keyword(text)")) {
+        foldDeclaration(tokens, start, end, inLoop);
+    } else if (end - start > 2 && tokenName(&tokens[start], name) && foldTokenIs(&tokens[start + 1], "Keyword(is)")) {
+        foldAssignment(out, start, end);
+    } else {
+        forgetIdentifiers(tokens, start, end);    // read and anything unusual
+    }
+}
+
+/* Folds the statements in [start, end), splitting them like splitLoopBody */
+void foldStatements(FoldOutput* out, int start, int end, int inLoop) {
+    const FoldToken* tokens = out->tokens;
+    int stmtStart = -1;
+    int hasBrace = 0;
+    for (int i = start; i < end; i++) {
+        if (foldTokenIs(&tokens[i], "EndOfLine")) {
+            if (stmtStart >= 0) {
+                if (hasBrace) forgetIdentifiers(tokens, stmtStart, i);
+                else foldStatement(out, stmtStart, i, inLoop);
+            }
+            stmtStart = -1;
+            hasBrace = 0;
+        } else if (stmtStart < 0 && foldTokenIs(&tokens[i], "Keyword(loop)")) {
+            int bodyStart, bodyEnd;
+            int loopEnd = foldLoopEnd(tokens, i, end, &bodyStart, &bodyEnd);
+            if (loopEnd < 0) {
+                forgetAssigned(tokens, i, end);
+                return;
+            }
+            // The count is read once, before the body runs
+            char name[32];
+            Variable* count = tokenName(&tokens[i + 1], name) ? knownLookup(name) : NULL;
+            if (count != NULL && count->type == INT) {
+                char literal[32];
+                snprintf(literal, sizeof(literal), "IntConst(%d)", knownStore.ints[count->slot]);
+                foldReplace(out, i + 1, i + 2, literal);
+            }
+            forgetAssigned(tokens, bodyStart, bodyEnd);
+            foldStatements(out, bodyStart, bodyEnd, 1);
+            forgetAssigned(tokens, bodyStart, bodyEnd);
+            i = loopEnd - 1;
+        } else if (foldTokenIs(&tokens[i], "LeftCurlyBracket") || foldTokenIs(&tokens[i], "RightCurlyBracket")) {
+            if (stmtStart >= 0) hasBrace = 1;
+        } else if (stmtStart < 0) {
+            stmtStart = i;
+        }
+    }
+    if (stmtStart >= 0) {
+        if (hasBrace) forgetIdentifiers(tokens, stmtStart, end);
+        else foldStatement(out, stmtStart, end, inLoop);
+    }
+}
+
+/* Splits an assembled statement into its tokens; the map gives the token boundaries */
+FoldToken* splitStatementTokens(const TextBuffer* line, const SourceMap* map) {
+    FoldToken* tokens = (FoldToken*)memAlloc(MEM_TEMP, map->count * sizeof(FoldToken));
+    for (int i = 0; i < map->count; i++) {
+        size_t tokenStart = map->positions[i].offset;
+        size_t tokenEnd = i + 1 < map->count ? (size_t)map->positions[i + 1].offset : line->length;
+        while (tokenEnd > tokenStart && line->data[tokenEnd - 1] == ' ') tokenEnd--;
+        tokens[i].text = line->data + tokenStart;
+        tokens[i].length = tokenEnd - tokenStart;
+        tokens[i].line = map->positions[i].line;
+        tokens[i].column = map->positions[i].column;
+    }
+    return tokens;
+}
+
+/* Folds one assembled top-level statement in place */
+void foldConstants(TextBuffer* line, SourceMap* map) {
+    if (map->count == 0) return;
+    FoldToken* tokens = splitStatementTokens(line, map);
+
+    FoldOutput out;
+    memset(&out, 0, sizeof(out));
+    out.tokens = tokens;
+    foldStatements(&out, 0, map->count, 0);
+
+    if (out.changed) {
+        // Copy the tokens after the last rewrite, then swap the statement
+        foldCopy(&out, map->count);
+        memFree(line->data);
+        memFree(map->positions);
+        *line = out.line;
+        *map = out.map;
+    } else {
+        memFree(out.line.data);
+        memFree(out.map.positions);
+    }
+    memFree(tokens);
+}
+
+/* Assembled and folded top-level statements, kept to run later (server program cache) */
+typedef struct {
+    char* text;
+    SourceMap map;
+} CompiledStatement;
+
+typedef struct {
+    CompiledStatement* statements;
+    int count;
+    int capacity;
+} CompiledProgram;
+
+/* Takes ownership of the statement's text and positions */
+void appendCompiledStatement(CompiledProgram* program, const CompiledStatement* stmt) {
+    if (program->count == program->capacity) {
+        program->capacity = program->capacity ? program->capacity * 2 : 16;
+        program->statements = (CompiledStatement*)memRealloc(MEM_PROGRAM, program->statements,
+                                                             program->capacity * sizeof(CompiledStatement));
+    }
+    program->statements[program->count++] = *stmt;
+}
+
+void freeCompiledProgram(CompiledProgram* program) {
+    for (int i = 0; i < program->count; i++) {
+        memFree(program->statements[i].text);
+        memFree(program->statements[i].map.positions);
+    }
+    memFree(program->statements);
+    memset(program, 0, sizeof(CompiledProgram));
+}
+
+/* Groups tokens into statements and runs each one as soon as it is complete */
+typedef struct {
+    TextBuffer line;        // Statement being assembled; a loop holds its whole body
+    SourceMap lineMap;
+    int inLoop;
+    int braceDepth;
+    int openLoops;                              // Loops of the statement not closed yet
+    int bracelessLoops[MAX_LOOP_DEPTH + 1];     // Open loops without braces, per brace depth
+    char loopBrace[MAX_LOOP_DEPTH + 1];         // Whether the brace opening each depth is a loop body
+    CompiledProgram* program;   // When set, statements are collected instead of run
+    VariableStore* checkStore;  // --check: statements are validated against these declarations instead
+    int rejected;               // --check: the statement nests too deep and is dropped
+} StatementBuilder;
+
+void checkStatement(const TextBuffer* line, const SourceMap* map, VariableStore* store);
+
+void runBuiltStatement(StatementBuilder* builder) {
+    if (foldEnabled && builder->checkStore == NULL) foldConstants(&builder->line, &builder->lineMap);
+    if (builder->checkStore != NULL) {
+        if (!builder->rejected) checkStatement(&builder->line, &builder->lineMap, builder->checkStore);
+        builder->rejected = 0;
+    } else if (builder->program != NULL) {
+        CompiledStatement stmt;
+        stmt.text = memStrdup(MEM_PROGRAM, builder->line.data);
+        stmt.map.count = stmt.map.capacity = builder->lineMap.count;
+        stmt.map.positions = (TokenPos*)memAlloc(MEM_PROGRAM, (stmt.map.count + 1) * sizeof(TokenPos));
+        memcpy(stmt.map.positions, builder->lineMap.positions, stmt.map.count * sizeof(TokenPos));
+        appendCompiledStatement(builder->program, &stmt);
+    } else {
+        executeStatement(builder->line.data, &builder->lineMap);
+    }
+    bufferClear(&builder->line);
+    builder->lineMap.count = 0;
+}
+
+void loopTooDeep(StatementBuilder* builder, int tokenLine, int tokenColumn) {
+    if (builder->checkStore != NULL) {
+        // Checking: reported once, and the statement is dropped when it is complete
+        if (!builder->rejected) addDiagnostic(tokenLine, tokenColumn, "Loops nested deeper than %d", MAX_LOOP_DEPTH);
+        builder->rejected = 1;
+        return;
+    }
+    printf("Error: Loops nested deeper than %d at line %d, column %d.\n", MAX_LOOP_DEPTH, tokenLine, tokenColumn);
+    exit(-1);
+}
+
+/* Follows the loop nesting of a loop statement the way splitLoopBody will split it, so a
+   statement nested too deep is rejected before folding or running recurses into it */
+void trackLoopNesting(StatementBuilder* builder, const char* text, int tokenLine, int tokenColumn) {
+    int* braceless = builder->bracelessLoops;
+    int level = builder->braceDepth > 0 ? builder->braceDepth : 0;   // A stray '}' leaves it negative
+    if (builder->rejected) {
+        // Only the end of a rejected statement is still looked for
+        if (strcmp(text, "LeftCurlyBracket") == 0) builder->braceDepth++;
+        else if (strcmp(text, "RightCurlyBracket") == 0) builder->braceDepth--;
+        return;
+    }
+    if (strcmp(text, "Keyword(loop)") == 0) {
+        if (++builder->openLoops > MAX_LOOP_DEPTH) loopTooDeep(builder, tokenLine, tokenColumn);
+        braceless[level]++;
+    } else if (strcmp(text, "LeftCurlyBracket") == 0) {
+        // The last loop header gets a braced body; any other brace only groups tokens
+        int opensLoop = braceless[level] > 0;
+        if (opensLoop) braceless[level]--;
+        if (++builder->braceDepth > MAX_LOOP_DEPTH) {
+            loopTooDeep(builder, tokenLine, tokenColumn);
+            return;
+        }
+        if (builder->braceDepth > 0) {
+            braceless[builder->braceDepth] = 0;
+            builder->loopBrace[builder->braceDepth] = (char)opensLoop;
+        }
+    } else if (strcmp(text, "RightCurlyBracket") == 0) {
+        if (builder->braceDepth > 0) {
+            // The braced loop ends, and so do the braceless loops it was the body of
+            builder->openLoops -= builder->loopBrace[builder->braceDepth] + braceless[builder->braceDepth - 1];
+            braceless[builder->braceDepth - 1] = 0;
+        }
+        builder->braceDepth--;
+    } else if (strcmp(text, "EndOfLine") == 0) {
+        builder->openLoops -= braceless[level];
+        braceless[level] = 0;
+    }
+}
+
+/* Adds one token text, e.g. Keyword(write), at its source position */
+void addStatementToken(StatementBuilder* builder, const char* text, int tokenLine, int tokenColumn) {
+    size_t tokenLength = strlen(text);
+    if (tokenLength == 0) return;
+
+    TextBuffer* line = &builder->line;
+    if (!builder->inLoop && strncmp(text, "Keyword(loop)", 13) == 0) {
+        builder->inLoop = 1;
+        builder->braceDepth = 0;
+        builder->openLoops = 0;
+        builder->bracelessLoops[0] = 0;
+        trackLoopNesting(builder, text, tokenLine, tokenColumn);
+        addTokenPos(&builder->lineMap, line->length, tokenLine, tokenColumn);
+        bufferAppend(line, text, tokenLength);
+    } else if (builder->inLoop) {
+        bufferAppend(line, " ", 1);
+        addTokenPos(&builder->lineMap, line->length, tokenLine, tokenColumn);
+        bufferAppend(line, text, tokenLength);
+        trackLoopNesting(builder, text, tokenLine, tokenColumn);
+        // A loop ends at its matching RightCurlyBracket, or at the '.' of a single statement body
+        if ((strcmp(text, "RightCurlyBracket") == 0 && builder->braceDepth == 0) ||
+            (strcmp(text, "EndOfLine") == 0 && builder->braceDepth == 0)) {
+            builder->inLoop = 0;
+            runBuiltStatement(builder);
+        }
+    } else {
+        if (strcmp(text, "EndOfLine") == 0) {
+            if (line->length > 0) {
+                runBuiltStatement(builder);
+            }
+        } else {
+            if (line->length > 0) bufferAppend(line, " ", 1);
+            addTokenPos(&builder->lineMap, line->length, tokenLine, tokenColumn);
+            bufferAppend(line, text, tokenLength);
+        }
+    }
+}
+
+/* Runs what is left at the end of the input and releases the builder */
+void finishStatements(StatementBuilder* builder) {
+    if (builder->line.length > 0) {
+        runBuiltStatement(builder);
+    }
+    memFree(builder->line.data);
+    memFree(builder->lineMap.positions);
+}
+
+/* Hands a token straight from the lexer to a builder, without the round trip through code.lex */
+void emitToBuilder(const Token* token, void* context) {
+    char text[MAX_STRING_SIZE + 32];
+    tokenCount++;
+    formatToken(token, text, sizeof(text));
+    removeComments(text);
+    addStatementToken((StatementBuilder*)context, text, token->line, token->column);
+}
+
+int Interpreter() {
+    FILE* file = fopen("code.lex", "r");
+    if (!file) {
+        printf("Error: Could not open file code.lex.\n");
+        return 1;
+    }
+
+    TextBuffer token = {0};
+    StatementBuilder builder = {0};
+
+    while (readLine(file, &token)) {
+        removeComments(token.data);
+
+        // printToken appends the source position after a tab
+        int tokenLine = 0, tokenColumn = 0;
+        char* position = strrchr(token.data, '\t');
+        if (position != NULL) {
+            sscanf(position + 1, "%d:%d", &tokenLine, &tokenColumn);
+            *position = '\0';
+        }
+        addStatementToken(&builder, token.data, tokenLine, tokenColumn);
+    }
+    finishStatements(&builder);
+
+    memFree(token.data);
+    fclose(file);
+    return 0;
+}
+
+
+#if PIPELINE_SUPPORTED
+/* Pipelined mode: a lexer thread pushes tokens into a lock-free single producer, single
+   consumer ring and the interpreter runs each statement as soon as its tokens arrive */
+#define TOKEN_RING_SIZE 4096        // Power of two
+
+typedef struct {
+    Token tokens[TOKEN_RING_SIZE];
+    _Atomic size_t head;            // Next slot to read, written only by the interpreter
+    _Atomic size_t tail;            // Next slot to write, written only by the lexer
+    _Atomic int done;               // Set by the lexer after its last token
+    FILE* inputFile;
+    FILE* outputFile;
+} TokenRing;
+
+/* Backs off while the other side catches up: spin first, then yield, then sleep */
+void ringWait(int* spins) {
+    if (++*spins < 64) return;
+    if (*spins < 128) {
+        sched_yield();
+        return;
+    }
+    struct timespec pause = { 0, 50000 };
+    nanosleep(&pause, NULL);
+}
+
+void emitToRing(const Token* token, void* context) {
+    TokenRing* ring = (TokenRing*)context;
+    printToken(ring->outputFile, *token);  // code.lex is still written for inspection
+
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    int spins = 0;
+    while (tail - atomic_load_explicit(&ring->head, memory_order_acquire) == TOKEN_RING_SIZE) {
+        ringWait(&spins);
+    }
+    ring->tokens[tail & (TOKEN_RING_SIZE - 1)] = *token;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+void* lexerThread(void* context) {
+    TokenRing* ring = (TokenRing*)context;
+    lexTokens(ring->inputFile, emitToRing, ring);
+    atomic_store_explicit(&ring->done, 1, memory_order_release);
+    return NULL;
+}
+
+/* Takes the next token; returns 0 once the lexer has finished and the ring is empty */
+int ringPop(TokenRing* ring, Token* token) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    int spins = 0;
+    while (head == atomic_load_explicit(&ring->tail, memory_order_acquire)) {
+        if (atomic_load_explicit(&ring->done, memory_order_acquire) &&
+            head == atomic_load_explicit(&ring->tail, memory_order_acquire)) {
+            return 0;
+        }
+        ringWait(&spins);
+    }
+    *token = ring->tokens[head & (TOKEN_RING_SIZE - 1)];
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return 1;
+}
+
+/* Lexes and interprets at the same time; the files are closed when both sides are done */
+int runPipeline(FILE* inputFile, FILE* outputFile) {
+    TokenRing* ring = (TokenRing*)memAlloc(MEM_LEXER, sizeof(TokenRing));
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->done, 0);
+    ring->inputFile = inputFile;
+    ring->outputFile = outputFile;
+
+    pthread_t lexer;
+    if (pthread_create(&lexer, NULL, lexerThread, ring) != 0) {
+        printf("Error: Could not start the lexer thread.\n");
+        memFree(ring);
+        return 1;
+    }
+
+    Token token;
+    StatementBuilder builder = {0};
+    while (ringPop(ring, &token)) {
+        memNote(MEM_LEXER, sizeof(Token));
+        emitToBuilder(&token, &builder);
+        memAccount(MEM_LEXER, -(long long)sizeof(Token));
+    }
+    finishStatements(&builder);
+
+    pthread_join(lexer, NULL);
+    fclose(inputFile);
+    fclose(outputFile);
+    memFree(ring);
+    return 0;
+}
+#endif
+
+
+#if SERVER_SUPPORTED
+/* Server mode: --serve PATH listens on a Unix domain socket. A request is a RequestHeader
+   followed by the script source and the data for read. Worker processes take turns in
+   accept(); each request runs in a child forked from its worker, so every script starts
+   from a fresh interpreter state, and the child's stdout is the connection, so output
+   streams back while the script runs. Workers cache compiled programs by the FNV-1a hash
+   of their source. A response ends with a NUL byte and the exit status of the run. */
+#define REQUEST_MAGIC 0x5152584C       // "LXRQ"
+#define REQUEST_LIMIT (64 << 20)       // Largest source or input accepted
+#define REQUEST_QUIET 1                // Run as with -q
+#define PROGRAM_CACHE_SIZE 64
+
+typedef struct {
+    unsigned int magic;
+    unsigned int flags;
+    unsigned int sourceLength;
+    unsigned int inputLength;
+} RequestHeader;
+
+typedef struct {
+    unsigned long long hash;
+    char* source;           // Compared in full, so a hash collision cannot run the wrong program
+    size_t sourceLength;
+    CompiledProgram program;
+} CachedProgram;
+
+CachedProgram programCache[PROGRAM_CACHE_SIZE];
+int programCacheNext = 0;   // Slot replaced next, oldest first
+
+int readFully(int fd, void* data, size_t length) {
+    char* p = (char*)data;
+    while (length > 0) {
+        ssize_t n = read(fd, p, length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        p += n;
+        length -= n;
+    }
+    return 1;
+}
+
+int writeFully(int fd, const void* data, size_t length) {
+    const char* p = (const char*)data;
+    while (length > 0) {
+        ssize_t n = write(fd, p, length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        p += n;
+        length -= n;
+    }
+    return 1;
+}
+
+/* Lexes, assembles and folds a script held in memory; lexer errors exit like they do in a run */
+void compileSource(const char* source, size_t length, CompiledProgram* program) {
+    StatementBuilder builder = {0};
+    builder.program = program;
+    if (length > 0) {
+        FILE* file = fmemopen((void*)source, length, "r");
+        if (file == NULL) {
+            printf("Error: Could not read the script.\n");
+            exit(-1);
+        }
+        lexTokens(file, emitToBuilder, &builder);
+        fclose(file);
+    }
+    finishStatements(&builder);
+}
+
+/* The child hands a freshly compiled program to its worker:
+   { textLength text positionCount positions } ... UINT_MAX */
+void sendProgram(int fd, const CompiledProgram* program) {
+    for (int i = 0; i < program->count; i++) {
+        const CompiledStatement* stmt = &program->statements[i];
+        unsigned int length = (unsigned int)strlen(stmt->text);
+        unsigned int count = (unsigned int)stmt->map.count;
+        if (!writeFully(fd, &length, sizeof(length)) || !writeFully(fd, stmt->text, length) ||
+            !writeFully(fd, &count, sizeof(count)) ||
+            !writeFully(fd, stmt->map.positions, count * sizeof(TokenPos))) return;
+    }
+    unsigned int end = UINT_MAX;
+    writeFully(fd, &end, sizeof(end));
+}
+
+/* Returns 1 if the whole program arrived */
+int receiveProgram(int fd, CompiledProgram* program) {
+    unsigned int length, count;
+    while (readFully(fd, &length, sizeof(length))) {
+        if (length == UINT_MAX) return 1;
+        if (length > REQUEST_LIMIT) return 0;
+
+        CompiledStatement stmt = { NULL, { NULL, 0, 0 } };
+        stmt.text = (char*)memAlloc(MEM_PROGRAM, length + 1);
+        int ok = readFully(fd, stmt.text, length) && readFully(fd, &count, sizeof(count)) && count <= REQUEST_LIMIT;
+        if (ok && count > 0) {
+            stmt.map.positions = (TokenPos*)memAlloc(MEM_PROGRAM, count * sizeof(TokenPos));
+            stmt.map.count = stmt.map.capacity = count;
+            ok = readFully(fd, stmt.map.positions, count * sizeof(TokenPos));
+        }
+        stmt.text[ok ? length : 0] = '\0';
+        appendCompiledStatement(program, &stmt);
+        if (!ok) return 0;
+    }
+    return 0;
+}
+
+CachedProgram* findCachedProgram(unsigned long long hash, const char* source, size_t length) {
+    for (int i = 0; i < PROGRAM_CACHE_SIZE; i++) {
+        CachedProgram* cached = &programCache[i];
+        if (cached->source != NULL && cached->hash == hash && cached->sourceLength == length &&
+            memcmp(cached->source, source, length) == 0) {
+            return cached;
+        }
+    }
+    return NULL;
+}
+
+void storeCachedProgram(unsigned long long hash, const char* source, size_t length, const CompiledProgram* program) {
+    CachedProgram* cached = &programCache[programCacheNext];
+    programCacheNext = (programCacheNext + 1) % PROGRAM_CACHE_SIZE;
+    memFree(cached->source);
+    freeCompiledProgram(&cached->program);
+
+    cached->hash = hash;
+    cached->source = (char*)memAlloc(MEM_PROGRAM, length + 1);
+    memcpy(cached->source, source, length);
+    cached->sourceLength = length;
+    cached->program = *program;
+}
+
+/* Runs in the forked child; never returns */
+void runRequest(int client, const RequestHeader* header, const char* source, const char* data,
+                const CachedProgram* cached, int programPipe) {
+    dup2(client, STDOUT_FILENO);
+    close(client);
+    quietMode = (header->flags & REQUEST_QUIET) != 0;
+    startLimits();
+    input->file = header->inputLength > 0 ? fmemopen((void*)data, header->inputLength, "r") : fopen("/dev/null", "r");
+
+    CompiledProgram compiled = { NULL, 0, 0 };
+    const CompiledProgram* program = &compiled;
+    if (cached != NULL) {
+        program = &cached->program;
+    } else {
+        compileSource(source, header->sourceLength, &compiled);
+        sendProgram(programPipe, &compiled);
+        close(programPipe);
+    }
+
+    for (int i = 0; i < program->count; i++) {
+        executeStatement(program->statements[i].text, &program->statements[i].map);
+    }
+    exit(0);
+}
+
+/* Reads one request, runs it in a child and reports how the child ended */
+void serveRequest(int client) {
+    RequestHeader header;
+    if (!readFully(client, &header, sizeof(header)) || header.magic != REQUEST_MAGIC ||
+        header.sourceLength > REQUEST_LIMIT || header.inputLength > REQUEST_LIMIT) {
+        return;
+    }
+    char* source = (char*)memAlloc(MEM_TEMP, header.sourceLength + 1);
+    char* data = (char*)memAlloc(MEM_TEMP, header.inputLength + 1);
+    if (readFully(client, source, header.sourceLength) && readFully(client, data, header.inputLength)) {
+        unsigned long long hash = hashBytes(FNV_OFFSET, source, header.sourceLength);
+        CachedProgram* cached = findCachedProgram(hash, source, header.sourceLength);
+        int programPipe[2] = { -1, -1 };
+        if (cached == NULL && pipe(programPipe) != 0) programPipe[0] = programPipe[1] = -1;
+
+        fflush(stdout);
+        pid_t child = fork();
+        if (child == 0) {
+            if (programPipe[0] >= 0) close(programPipe[0]);
+            runRequest(client, &header, source, data, cached, programPipe[1]);
+        }
+
+        if (programPipe[0] >= 0) {
+            // A program whose lexing failed never arrives whole and is not cached
+            CompiledProgram program = { NULL, 0, 0 };
+            close(programPipe[1]);
+            if (child > 0 && receiveProgram(programPipe[0], &program)) {
+                storeCachedProgram(hash, source, header.sourceLength, &program);
+            } else {
+                freeCompiledProgram(&program);
+            }
+            close(programPipe[0]);
+        }
+
+        int status = 0;
+        unsigned char trailer[2] = { 0, 255 };
+        if (child > 0 && waitpid(child, &status, 0) == child) {
+            trailer[1] = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        }
+        writeFully(client, trailer, sizeof(trailer));
+    }
+    memFree(source);
+    memFree(data);
+}
+
+void serveWorker(int listener) {
+    for (;;) {
+        int client = accept(listener, NULL, NULL);
+        if (client < 0) continue;
+        serveRequest(client);
+        close(client);
+    }
+}
+
+int openServerSocket(const char* path, struct sockaddr_un* address) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address->sun_path)) {
+        printf("Error: Socket path %s is too long.\n", path);
+        return -1;
+    }
+    strcpy(address->sun_path, path);
+    return socket(AF_UNIX, SOCK_STREAM, 0);
+}
+
+/* Starts the worker pool and replaces workers that die */
+int runServer(const char* path, int workers) {
+    struct sockaddr_un address;
+    int listener = openServerSocket(path, &address);
+    if (listener < 0) return -1;
+    unlink(path);
+    if (bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 128) != 0) {
+        printf("Error: Could not listen on %s.\n", path);
+        return -1;
+    }
+    signal(SIGPIPE, SIG_IGN);   // A client that hangs up only ends its own run
+
+    printf("Serving on %s with %d workers.\n", path, workers);
+    fflush(stdout);
+    for (int i = 0; i < workers; i++) {
+        if (fork() == 0) serveWorker(listener);
+    }
+    while (wait(NULL) > 0) {
+        if (fork() == 0) serveWorker(listener);
+    }
+    return 0;
+}
+
+int connectServer(const char* path) {
+    struct sockaddr_un address;
+    int fd = openServerSocket(path, &address);
+    if (fd >= 0 && connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+/* Reads a whole file or stream into memory */
+char* readWhole(FILE* file, size_t* length) {
+    TextBuffer buffer = { NULL, 0, 0 };
+    char chunk[65536];
+    size_t n;
+    bufferAppend(&buffer, "", 0);
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        bufferAppend(&buffer, chunk, n);
+    }
+    *length = buffer.length;
+    return buffer.data;
+}
+
+int sendRequest(int fd, unsigned int flags, const char* source, size_t sourceLength, const char* data, size_t dataLength) {
+    RequestHeader header = { REQUEST_MAGIC, flags, (unsigned int)sourceLength, (unsigned int)dataLength };
+    return writeFully(fd, &header, sizeof(header)) && writeFully(fd, source, sourceLength) &&
+           writeFully(fd, data, dataLength);
+}
+
+/* Copies the streamed output to out (NULL drops it) and returns the exit status of the run.
+   The last two bytes are held back until the stream ends, since they may be the trailer. */
+int receiveResponse(int fd, FILE* out) {
+    char chunk[65536 + 2];
+    size_t held = 0;
+    ssize_t n;
+    while ((n = read(fd, chunk + held, sizeof(chunk) - held)) > 0 || (n < 0 && errno == EINTR)) {
+        if (n < 0) continue;
+        held += n;
+        if (held > 2) {
+            if (out != NULL) fwrite(chunk, 1, held - 2, out);
+            memmove(chunk, chunk + held - 2, 2);
+            held = 2;
+        }
+    }
+    if (held == 2 && chunk[0] == '\0') return (unsigned char)chunk[1];
+    if (out != NULL) fwrite(chunk, 1, held, out);
+    return -1;      // The server went away before the run ended
+}
+
+/* --client PATH: runs code.sta (or --script FILE) on the server; stdin is sent when it is not a terminal */
+int runClient(const char* path, const char* script) {
+    FILE* file = fopen(script, "rb");
+    if (file == NULL) {
+        printf("Error: Could not open %s.\n", script);
+        return -1;
+    }
+    size_t sourceLength, dataLength = 0;
+    char* source = readWhole(file, &sourceLength);
+    fclose(file);
+    char* data = isatty(fileno(stdin)) ? memStrdup(MEM_TEMP, "") : readWhole(stdin, &dataLength);
+
+    int fd = connectServer(path);
+    int status = -1;
+    if (fd < 0) {
+        printf("Error: Could not connect to %s.\n", path);
+    } else {
+        if (sendRequest(fd, quietMode ? REQUEST_QUIET : 0, source, sourceLength, data, dataLength)) {
+            status = receiveResponse(fd, stdout);
+        }
+        close(fd);
+    }
+    memFree(source);
+    memFree(data);
+    return status;
+}
+
+/* --bench PATH: a load generator; each thread sends requests back to back */
+typedef struct {
+    const char* path;
+    const char* source;
+    size_t sourceLength;
+    double* latencies;      // Milliseconds, one per request of this thread
+    int requests;
+    int failures;
+} BenchThread;
+
+void* benchThread(void* context) {
+    BenchThread* bench = (BenchThread*)context;
+    for (int i = 0; i < bench->requests; i++) {
+        long long start = profileNow();
+        int fd = connectServer(bench->path);
+        int status = -1;
+        if (fd >= 0) {
+            if (sendRequest(fd, REQUEST_QUIET, bench->source, bench->sourceLength, "", 0)) {
+                status = receiveResponse(fd, NULL);
             }
+            close(fd);
+        }
+        if (status != 0) bench->failures++;
+        bench->latencies[i] = (profileNow() - start) / 1e6;
+    }
+    return NULL;
+}
 
-            token = strtok(NULL, " ");
+int compareLatencies(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+int runBench(const char* path, const char* script, int requests, int concurrency) {
+    FILE* file = fopen(script, "rb");
+    if (file == NULL) {
+        printf("Error: Could not open %s.\n", script);
+        return -1;
+    }
+    size_t sourceLength;
+    char* source = readWhole(file, &sourceLength);
+    fclose(file);
+
+    double* latencies = (double*)memAlloc(MEM_TEMP, requests * sizeof(double));
+    BenchThread* threads = (BenchThread*)memCalloc(MEM_TEMP, concurrency, sizeof(BenchThread));
+    pthread_t* ids = (pthread_t*)memAlloc(MEM_TEMP, concurrency * sizeof(pthread_t));
+    long long start = profileNow();
+    for (int i = 0, first = 0; i < concurrency; i++) {
+        threads[i].path = path;
+        threads[i].source = source;
+        threads[i].sourceLength = sourceLength;
+        threads[i].requests = requests / concurrency + (i < requests % concurrency);
+        threads[i].latencies = latencies + first;
+        first += threads[i].requests;
+        pthread_create(&ids[i], NULL, benchThread, &threads[i]);
+    }
+    int failures = 0;
+    for (int i = 0; i < concurrency; i++) {
+        pthread_join(ids[i], NULL);
+        failures += threads[i].failures;
+    }
+    double seconds = (profileNow() - start) / 1e9;
+
+    qsort(latencies, requests, sizeof(double), compareLatencies);
+    printf("Requests: %d, concurrency: %d, failures: %d\n", requests, concurrency, failures);
+    printf("Throughput: %.1f requests/s\n", requests / seconds);
+    printf("Latency ms: p50 %.3f  p99 %.3f  max %.3f\n",
+           latencies[requests / 2], latencies[(int)(requests * 0.99)], latencies[requests - 1]);
+
+    memFree(ids);
+    memFree(threads);
+    memFree(latencies);
+    memFree(source);
+    return failures > 0;
+}
+#endif
+
+
+#if SCHEDULER_SUPPORTED
+/* Cooperative scheduler: many scripts share one thread. Each script runs on its own ucontext
+   stack; when read finds its input channel empty the script flushes its output and yields,
+   and the event loop resumes it once poll reports data. The interpreter state of a script
+   (variables, loop frames, counters, input reader, stdout) is swapped in before it runs and
+   saved when it yields. --harness N runs N copies of a script this way, with their input fed
+   through pipes by a separate process. */
+#define SCRIPT_STACK_SIZE (256 << 10)
+#define HARNESS_FEED_DELAY 1000         // Microseconds between two values written to every pipe
+
+/* Interpreter state that belongs to one script */
+typedef struct {
+    VariableStore variables;
+    LoopFrame* loopFrames;
+    int loopDepth;
+    int loopFramesCapacity;
+    long long topStatementIndex;
+    long long statementCount;
+    long long limitDeadline;
+    int limitClockCountdown;
+    long long textBytes;
+    InputReader* input;
+    FILE* output;
+} ScriptState;
+
+typedef struct Script {
+    ucontext_t context;
+    void* stack;
+    const CompiledProgram* program;
+    TextBuffer line;        // Statement being run
+    int inputFd;            // Non-blocking read end of the input channel
+    ScriptState state;      // Saved while the script is not running
+    char* output;           // Output collected by the memory stream
+    size_t outputLength;
+    int waiting;            // Suspended until inputFd is readable
+    int done;
+    int status;             // Exit status once done
+} Script;
+
+ucontext_t schedulerContext;
+long long suspensions = 0;      // Times a script yielded for input
+
+void swapScriptState(ScriptState* save, const ScriptState* load) {
+    save->variables = variables;
+    save->loopFrames = loopFrames;
+    save->loopDepth = loopDepth;
+    save->loopFramesCapacity = loopFramesCapacity;
+    save->topStatementIndex = topStatementIndex;
+    save->statementCount = statementCount;
+    save->limitDeadline = limitDeadline;
+    save->limitClockCountdown = limitClockCountdown;
+    save->textBytes = textBytes;
+    save->input = input;
+    save->output = stdout;
+
+    variables = load->variables;
+    loopFrames = load->loopFrames;
+    loopDepth = load->loopDepth;
+    loopFramesCapacity = load->loopFramesCapacity;
+    topStatementIndex = load->topStatementIndex;
+    statementCount = load->statementCount;
+    limitDeadline = load->limitDeadline;
+    limitClockCountdown = load->limitClockCountdown;
+    textBytes = load->textBytes;
+    input = load->input;
+    stdout = load->output;      // glibc and the BSDs keep stdout in an assignable variable
+}
+
+/* Reads what the input channel of the running script has, yielding while it is empty */
+size_t scriptRead(char* data, size_t size) {
+    Script* script = currentScript;
+    for (;;) {
+        ssize_t n = read(script->inputFd, data, size);
+        if (n >= 0) return (size_t)n;
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) return 0;
+        fflush(stdout);                 // The prompt reaches the client before the wait
+        script->waiting = 1;
+        suspensions++;
+        swapcontext(&script->context, &schedulerContext);
+    }
+}
+
+/* Called on the script's own stack; never returns */
+void finishScript(int status) {
+    Script* script = currentScript;
+    fflush(stdout);
+    script->status = status;
+    script->done = 1;
+    setcontext(&schedulerContext);
+}
+
+void scriptMain(void) {
+    Script* script = currentScript;
+    const CompiledProgram* program = script->program;
+    startLimits();
+    for (int i = 0; i < program->count; i++) {
+        // Handlers cut the statement text in place and the program is shared, so each script runs a copy
+        bufferClear(&script->line);
+        bufferAppend(&script->line, program->statements[i].text, strlen(program->statements[i].text));
+        executeStatement(script->line.data, &program->statements[i].map);
+    }
+    finishScript(0);
+}
+
+void startScript(Script* script, const CompiledProgram* program, int inputFd) {
+    memset(script, 0, sizeof(Script));
+    script->program = program;
+    script->inputFd = inputFd;
+    script->stack = memAlloc(MEM_PROGRAM, SCRIPT_STACK_SIZE);
+    script->state.limitClockCountdown = LIMIT_CLOCK_EVERY;
+    script->state.input = (InputReader*)memAlloc(MEM_PROGRAM, sizeof(InputReader));
+    script->state.input->position = script->state.input->length = 0;
+    script->state.input->file = NULL;
+    script->state.output = open_memstream(&script->output, &script->outputLength);
+
+    getcontext(&script->context);
+    script->context.uc_stack.ss_sp = script->stack;
+    script->context.uc_stack.ss_size = SCRIPT_STACK_SIZE;
+    script->context.uc_link = &schedulerContext;
+    makecontext(&script->context, scriptMain, 0);
+}
+
+/* Runs the script until it waits for input or ends */
+void resumeScript(Script* script) {
+    ScriptState scheduler;
+    swapScriptState(&scheduler, &script->state);
+    currentScript = script;
+    script->waiting = 0;
+    swapcontext(&schedulerContext, &script->context);
+    currentScript = NULL;
+    swapScriptState(&script->state, &scheduler);
+
+    if (script->done) {
+        ScriptState* state = &script->state;
+        statementCount += state->statementCount;    // --stats shows the total of all scripts
+        for (int i = 0; i < state->variables.textCount; i++) memFree(state->variables.texts[i].data);
+        memFree(state->loopFrames);
+        memFree(state->input);
+        memFree(script->stack);
+        memFree(script->line.data);
+        fclose(state->output);
+        close(script->inputFd);
+        script->stack = NULL;
+    }
+}
+
+/* Event loop: runs every ready script, then sleeps in poll until some waiting one has input */
+void runScheduler(Script* scripts, int count) {
+    struct pollfd* fds = (struct pollfd*)memAlloc(MEM_TEMP, count * sizeof(struct pollfd));
+    int* owners = (int*)memAlloc(MEM_TEMP, count * sizeof(int));
+    int* ready = (int*)memAlloc(MEM_TEMP, count * sizeof(int));
+    int readyCount = count;
+    for (int i = 0; i < count; i++) ready[i] = i;
+
+    for (;;) {
+        for (int i = 0; i < readyCount; i++) resumeScript(&scripts[ready[i]]);
+
+        int waitingCount = 0;
+        for (int i = 0; i < count; i++) {
+            if (scripts[i].done || !scripts[i].waiting) continue;
+            fds[waitingCount].fd = scripts[i].inputFd;
+            fds[waitingCount].events = POLLIN;
+            owners[waitingCount++] = i;
         }
+        if (waitingCount == 0) break;
+        while (poll(fds, waitingCount, -1) < 0 && errno == EINTR) {}
 
-        if (inStatement && !innerLoopActive) {
-            execute(statement);
+        readyCount = 0;
+        for (int i = 0; i < waitingCount; i++) {
+            if (fds[i].revents != 0) ready[readyCount++] = owners[i];
         }
+    }
+    memFree(fds);
+    memFree(owners);
+    memFree(ready);
+}
 
-        // Her iterasyon sonunda Identifier(i) değerini incrementValue kadar artır
-        Variable *var = getVariable("i");
-        if (var != NULL) {
-            var->intValue += incrementValue;
-        } else {
-            printf("Error: Variable 'i' is not declared.\n");
+/* Writes the input to every pipe one blank separated value at a time, like slow clients */
+void feedPipes(const int* pipes, int count, const char* data, size_t length) {
+    signal(SIGPIPE, SIG_IGN);
+    char* open = (char*)memAlloc(MEM_TEMP, count);
+    memset(open, 1, count);
+    size_t start = 0;
+    while (start < length) {
+        size_t end = start;
+        while (end < length && isspace((unsigned char)data[end])) end++;
+        while (end < length && !isspace((unsigned char)data[end])) end++;
+        while (end < length && isspace((unsigned char)data[end]) && data[end - 1] != '\n') end++;
+        for (int i = 0; i < count; i++) {
+            if (open[i] && !writeFully(pipes[i], data + start, end - start)) open[i] = 0;
         }
+        start = end;
+        usleep(HARNESS_FEED_DELAY);
     }
+    memFree(open);
 }
 
-void handleIsStatement(const char* line) {
-    char varName[32], expression[256];
-    sscanf(line, " Identifier(%31[^)]) Operator(is) %255[^\n]", varName, expression);
-    handleAssignment(varName, expression);
+int runHarness(const char* path, const char* inputPath, int count) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("Error: Could not open %s.\n", path);
+        return -1;
+    }
+    size_t sourceLength, dataLength = 0;
+    char* source = readWhole(file, &sourceLength);
+    fclose(file);
+    char* data = NULL;
+    if (inputPath != NULL) {
+        file = fopen(inputPath, "rb");
+        if (file == NULL) {
+            printf("Error: Could not open %s.\n", inputPath);
+            return -1;
+        }
+        data = readWhole(file, &dataLength);
+        fclose(file);
+    }
+
+    // Two descriptors per script
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < (rlim_t)count * 2 + 16) {
+        limit.rlim_cur = limit.rlim_max < (rlim_t)count * 2 + 16 ? limit.rlim_max : (rlim_t)count * 2 + 16;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    CompiledProgram program = { NULL, 0, 0 };
+    compileSource(source, sourceLength, &program);
+
+    Script* scripts = (Script*)memAlloc(MEM_PROGRAM, count * sizeof(Script));
+    int* writers = (int*)memAlloc(MEM_TEMP, count * sizeof(int));
+    for (int i = 0; i < count; i++) {
+        int channel[2];
+        if (pipe(channel) != 0) {
+            printf("Error: Could not create input pipe %d of %d.\n", i + 1, count);
+            return -1;
+        }
+        fcntl(channel[0], F_SETFL, fcntl(channel[0], F_GETFL) | O_NONBLOCK);
+        writers[i] = channel[1];
+        startScript(&scripts[i], &program, channel[0]);
+    }
+
+    fflush(stdout);
+    pid_t feeder = fork();
+    if (feeder == 0) {
+        for (int i = 0; i < count; i++) close(scripts[i].inputFd);
+        feedPipes(writers, count, data, dataLength);
+        _exit(0);
+    }
+    for (int i = 0; i < count; i++) close(writers[i]);
+
+    long long start = profileNow();
+    runScheduler(scripts, count);
+    double seconds = (profileNow() - start) / 1e9;
+    waitpid(feeder, NULL, 0);
+
+    // Every copy got the same input, so every output should match the first
+    int same = 0, failed = 0;
+    for (int i = 0; i < count; i++) {
+        if (scripts[i].outputLength == scripts[0].outputLength &&
+            memcmp(scripts[i].output, scripts[0].output, scripts[0].outputLength) == 0) same++;
+        if (scripts[i].status != 0) failed++;
+    }
+    fwrite(scripts[0].output, 1, scripts[0].outputLength, stdout);
+    fflush(stdout);
+    fprintf(stderr, "Scripts: %d, same output as the first: %d, failed: %d\n", count, same, failed);
+    fprintf(stderr, "Suspensions on read: %lld\n", suspensions);
+    fprintf(stderr, "Time: %.3f s on one thread\n", seconds);
+
+    for (int i = 0; i < count; i++) free(scripts[i].output);
+    memFree(scripts);
+    memFree(writers);
+    memFree(source);
+    memFree(data);
+    freeCompiledProgram(&program);
+    return failed == 0 && same == count ? 0 : 1;
 }
+#endif
 
 
-void execute(const char* line) {
 
-    if (strncmp(line, "Keyword(write)", 14) == 0) {
-        handleIO("Keyword(write)", line + 14);
-    } else if (strncmp(line, "Keyword(int)", 12) == 0) {
-        handleDeclaration(line);
-    } else if (strncmp(line, "Keyword(text)", 13) == 0) {
-        handleDeclaration(line);
-    } else if (strncmp(line, "Keyword(read)", 13) == 0) {
-        char command[32], rest[256];
-        sscanf(line, "%31s %255[^\n]", command, rest);
-        handleIO(command, rest);
-    } else if (strncmp(line, "Keyword(newLine)", 16) == 0) {
-        handleIO("Keyword(newLine)", NULL);
-    } else if (strncmp(line, "Keyword(loop)", 13) == 0) {
-        int loopCount;
-        const char* loopCountStart = strstr(line, "IntConst(") + strlen("IntConst(");
-        sscanf(loopCountStart, "%d", &loopCount);
-
-        const char* loopBodyStart = strstr(line, "LeftCurlyBracket") + strlen("LeftCurlyBracket");
-        const char* loopBodyEnd = strrchr(line, 'R'); // "RightCurlyBracket" yerine son 'R' karakterini bulma
-        if (loopBodyEnd != NULL) {
-            char loopBody[4096];
-            strncpy(loopBody, loopBodyStart, loopBodyEnd - loopBodyStart - 1); // Sağ küme parantezden bir önceki karaktere kadar al
-            loopBody[loopBodyEnd - loopBodyStart - 1] = '\0';
-
-            handleLoop(loopCount, loopBody);
+/* Check-only mode: files are lexed and their statements validated, nothing is run. Lexer
+   errors, loops nested too deep and statements the interpreter would reject are collected with
+   their line and column, and checking goes on with the next token or statement; each statement
+   reports its first problem. Declarations are followed in source order, so a name is known from
+   the statement that declares or first assigns it. Files are shared out to forked workers that
+   take the next file from a shared counter and write their results to a temporary file. */
+long long checkedStatements = 0;    // Top-level statements checked by this process
+
+void checkError(const FoldToken* token, const char* format, ...) {
+    char message[MAX_STRING_SIZE + 64];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    addDiagnostic(token->line, token->column, "%s", message);
+}
+
+Variable* checkLookup(VariableStore* store, const FoldToken* token) {
+    char name[32];
+    return tokenName(token, name) ? findVariable(store, name) : NULL;
+}
+
+/* Accepts what evaluateInt and evaluateText accept for a variable of the given type */
+void checkExpression(VariableStore* store, const FoldToken* tokens, int start, int end, VarType type) {
+    char name[32];
+    if (start >= end) {
+        checkError(&tokens[start - 1], "Invalid assignment");
+        return;
+    }
+    for (int i = start; i < end; i++) {
+        const FoldToken* token = &tokens[i];
+        if (foldTokenIs(token, "Operator(+)") || foldTokenIs(token, "Operator(-)")) continue;
+        if (tokenName(token, name)) {
+            Variable* var = findVariable(store, name);
+            if (var == NULL || var->type != type) {
+                checkError(token, type == INT ? "Invalid integer assignment for %s" : "Invalid text assignment for %s", name);
+                return;
+            }
+        } else if (type == INT && strncmp(token->text, "IntConst(", 9) == 0) {
+            continue;
+        } else if (type == INT && foldTokenIs(token, "Operator(/)")) {
+            // The divisor has to be a constant
+            if (i + 1 >= end || strncmp(tokens[i + 1].text, "IntConst(", 9) != 0) {
+                checkError(token, "Invalid expression");
+                return;
+            }
+            if (atoi(tokens[i + 1].text + 9) == 0) {
+                checkError(&tokens[i + 1], "Division by zero");
+                return;
+            }
+            i++;
+        } else if (type == TEXT && (strncmp(token->text, "String(", 7) == 0 || foldTokenIs(token, "Keyword(is)"))) {
+            continue;
         } else {
-            printf("Error: Missing RightCurlyBracket in loop.\n");
+            checkError(token, "Unexpected token %.*s", (int)token->length, token->text);
+            return;
         }
-    } else if (strncmp(line, "Keyword(is)", 11) == 0) {
-        handleIsStatement(line + 11);
-    } else if (strstr(line, "Keyword(is)") != NULL) {
-        char varName[32], expression[256];
-        sscanf(line, "Identifier(%31[^)]) Keyword(is) %255[^\n]", varName, expression);
-        handleAssignment(varName, expression);
+    }
+}
+
+void checkDeclaration(VariableStore* store, const FoldToken* tokens, int start, int end) {
+    VarType type = foldTokenIs(&tokens[start], "Keyword(int)") ? INT : TEXT;
+    const char* literal = type == INT ? "IntConst(" : "String(";
+    int i = start + 1;
+    for (;;) {
+        char name[32];
+        if (i >= end) {
+            checkError(&tokens[i - 1], "Expected a variable name after %.*s", (int)tokens[i - 1].length, tokens[i - 1].text);
+            return;
+        }
+        if (!tokenName(&tokens[i], name)) {
+            checkError(&tokens[i], "Expected a variable name, found %.*s", (int)tokens[i].length, tokens[i].text);
+            return;
+        }
+        i++;
+        if (i < end && foldTokenIs(&tokens[i], "Keyword(is)")) {
+            if (++i >= end || strncmp(tokens[i].text, literal, strlen(literal)) != 0) {
+                checkError(&tokens[i < end ? i : i - 1], "Invalid assignment for variable %s", name);
+                return;
+            }
+            i++;
+        }
+        if (findVariable(store, name) == NULL && addVariable(store, name, type) == NULL) {
+            checkError(&tokens[start], "Too many variables declared");
+            return;
+        }
+        if (i >= end) return;
+        if (!foldTokenIs(&tokens[i], "Comma")) {
+            checkError(&tokens[i], "Unexpected token %.*s", (int)tokens[i].length, tokens[i].text);
+            return;
+        }
+        i++;
+    }
+}
+
+/* One statement without loops; brace is its first brace, or -1 */
+void checkSimpleStatement(VariableStore* store, const FoldToken* tokens, int start, int end, int brace) {
+    const FoldToken* first = &tokens[start];
+    char name[32];
+    if (brace >= 0) {
+        checkError(&tokens[brace], "Unexpected token %.*s", (int)tokens[brace].length, tokens[brace].text);
+    } else if (foldTokenIs(first, "Keyword(int)") || foldTokenIs(first, "Keyword(text)")) {
+        checkDeclaration(store, tokens, start, end);
+    } else if (foldTokenIs(first, "Keyword(read)")) {
+        int i = start + 1;
+        if (i < end && strncmp(tokens[i].text, "String(", 7) == 0) i++;
+        if (i >= end || !tokenName(&tokens[i], name)) {
+            checkError(first, "read needs a variable");
+        } else if (findVariable(store, name) == NULL) {
+            checkError(&tokens[i], "Tanımlanmamış değişken %s", name);
+        } else if (i + 1 < end) {
+            checkError(&tokens[i + 1], "Unexpected token %.*s", (int)tokens[i + 1].length, tokens[i + 1].text);
+        }
+    } else if (foldTokenIs(first, "Keyword(write)")) {
+        for (int i = start + 1; i < end; i++) {
+            if (tokenName(&tokens[i], name)) {
+                if (findVariable(store, name) == NULL) {
+                    checkError(&tokens[i], "Tanımlanmamış değişken %s", name);
+                    return;
+                }
+            } else if (strncmp(tokens[i].text, "String(", 7) != 0 && !foldTokenIs(&tokens[i], "Comma")) {
+                checkError(&tokens[i], "Unexpected token %.*s", (int)tokens[i].length, tokens[i].text);
+                return;
+            }
+        }
+    } else if (foldTokenIs(first, "Keyword(newLine)")) {
+        if (start + 1 < end) {
+            checkError(&tokens[start + 1], "Unexpected token %.*s", (int)tokens[start + 1].length, tokens[start + 1].text);
+        }
+    } else if (tokenName(first, name) && start + 1 < end && foldTokenIs(&tokens[start + 1], "Keyword(is)")) {
+        // Like handleAssignment, an unknown name is declared by its first assignment
+        Variable* var = findVariable(store, name);
+        if (var == NULL) {
+            VarType type = INT;
+            for (int i = start + 2; i < end; i++) {
+                if (strncmp(tokens[i].text, "String(", 7) == 0) type = TEXT;
+            }
+            var = addVariable(store, name, type);
+            if (var == NULL) {
+                checkError(first, "Too many variables declared");
+                return;
+            }
+        }
+        checkExpression(store, tokens, start + 2, end, var->type);
     } else {
-        printf("Error: Unrecognized keyword.\n");
+        for (int i = start; i < end; i++) {
+            if (foldTokenIs(&tokens[i], "Keyword(is)")) {
+                checkError(first, "Invalid assignment");
+                return;
+            }
+        }
+        checkError(first, "Unrecognized keyword %.*s", (int)first->length, first->text);
+    }
+}
+
+/* Checks the statements in [start, end), splitting them like foldStatements */
+void checkStatements(VariableStore* store, const FoldToken* tokens, int start, int end, int inLoop) {
+    int stmtStart = -1;
+    int brace = -1;
+    for (int i = start; i < end; i++) {
+        if (foldTokenIs(&tokens[i], "EndOfLine")) {
+            if (stmtStart >= 0) checkSimpleStatement(store, tokens, stmtStart, i, brace);
+            stmtStart = -1;
+            brace = -1;
+        } else if (stmtStart < 0 && foldTokenIs(&tokens[i], "Keyword(loop)")) {
+            const FoldToken* count = i + 1 < end ? &tokens[i + 1] : &tokens[i];
+            Variable* var = checkLookup(store, count);
+            int countValid = strncmp(count->text, "IntConst(", 9) == 0 || (var != NULL && var->type == INT);
+            if (!countValid) checkError(count, "Invalid loop count %.*s", (int)count->length, count->text);
+
+            int bodyStart, bodyEnd;
+            int loopEnd = foldLoopEnd(tokens, i, end, &bodyStart, &bodyEnd);
+            if (loopEnd < 0) {
+                // The rest of the statement cannot be split into a body; a bad count is reported already
+                if (countValid && (i + 2 >= end || !foldTokenIs(&tokens[i + 2], "Keyword(times)"))) {
+                    checkError(&tokens[i + 2 < end ? i + 2 : end - 1], "Expected 'times' after the loop count");
+                } else if (countValid) {
+                    checkError(&tokens[i + 3], "Missing RightCurlyBracket in loop");
+                }
+                return;
+            }
+            if (bodyStart >= bodyEnd) checkError(&tokens[i + 2], "Missing loop body");
+            checkStatements(store, tokens, bodyStart, bodyEnd, 1);
+            i = loopEnd - 1;
+        } else if (foldTokenIs(&tokens[i], "LeftCurlyBracket") || foldTokenIs(&tokens[i], "RightCurlyBracket")) {
+            // Loop bodies ignore braces between statements; at the top level they start a bad statement
+            if (stmtStart >= 0) {
+                if (brace < 0) brace = i;
+            } else if (!inLoop) {
+                checkError(&tokens[i], "Unexpected token %.*s", (int)tokens[i].length, tokens[i].text);
+            }
+        } else if (stmtStart < 0) {
+            stmtStart = i;
+        }
     }
+    if (stmtStart >= 0) checkSimpleStatement(store, tokens, stmtStart, end, brace);
 }
 
+/* Called by the statement builder for each assembled top-level statement */
+void checkStatement(const TextBuffer* line, const SourceMap* map, VariableStore* store) {
+    if (map->count == 0) return;
+    FoldToken* tokens = splitStatementTokens(line, map);
+    checkStatements(store, tokens, 0, map->count, 0);
+    memFree(tokens);
+    checkedStatements++;
+}
 
+/* Lexes and checks one file, then writes its records:
+     D index line column message      for each diagnostic, in source order
+     F index tokens statements        once the file is done */
+void checkFile(const char* path, int index, FILE* records) {
+    DiagnosticList list = { NULL, 0, 0 };
+    long long firstToken = tokenCount, firstStatement = checkedStatements;
+    diagnostics = &list;
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        addDiagnostic(0, 0, "Could not open the file");
+    } else {
+        VariableStore* store = (VariableStore*)memCalloc(MEM_TEMP, 1, sizeof(VariableStore));
+        StatementBuilder builder = {0};
+        builder.checkStore = store;
+        lexLine = lexColumn = lexPrevColumn = 1;
+        lexTokens(file, emitToBuilder, &builder);
+        finishStatements(&builder);
+        fclose(file);
+        for (int i = 0; i < store->textCount; i++) textFree(&store->texts[i]);
+        memFree(store);
+    }
+    diagnostics = NULL;
 
-void removeComments(char* line) {
-    char* start = strstr(line, "/*");
-    while (start != NULL) {
-        char* end = strstr(start + 2, "*/");
-        if (end != NULL) {
-            memmove(start, end + 2, strlen(end + 2) + 1);
-        } else {
-            *start = '\0';
+    // Statements are checked when they end, so the list is nearly sorted already
+    for (int i = 1; i < list.count; i++) {
+        Diagnostic item = list.items[i];
+        int j = i;
+        while (j > 0 && (list.items[j - 1].line > item.line ||
+                         (list.items[j - 1].line == item.line && list.items[j - 1].column > item.column))) {
+            list.items[j] = list.items[j - 1];
+            j--;
         }
-        start = strstr(line, "/*");
+        list.items[j] = item;
     }
+    for (int i = 0; i < list.count; i++) {
+        fprintf(records, "D\t%d\t%d\t%d\t%s\n", index, list.items[i].line, list.items[i].column, list.items[i].message);
+        memFree(list.items[i].message);
+    }
+    fprintf(records, "F\t%d\t%lld\t%lld\n", index, tokenCount - firstToken, checkedStatements - firstStatement);
+    memFree(list.items);
 }
 
-int Interpreter() {
-    FILE* file = fopen("code.lex", "r");
-    if (!file) {
-        printf("Error: Could not open file code.lex.\n");
+/* Files named on the command line; @LIST adds the paths listed in LIST, one per line */
+typedef struct {
+    char** items;
+    int count;
+    int capacity;
+} PathList;
+
+void addCheckPath(PathList* paths, const char* path) {
+    if (paths->count == paths->capacity) {
+        paths->capacity = paths->capacity ? paths->capacity * 2 : 64;
+        paths->items = (char**)memRealloc(MEM_PROGRAM, paths->items, paths->capacity * sizeof(char*));
+    }
+    paths->items[paths->count++] = memStrdup(MEM_PROGRAM, path);
+}
+
+int addCheckArgument(PathList* paths, const char* argument) {
+    if (argument[0] != '@') {
+        addCheckPath(paths, argument);
         return 1;
     }
+    FILE* list = fopen(argument + 1, "r");
+    if (list == NULL) {
+        printf("Error: Could not open %s.\n", argument + 1);
+        return 0;
+    }
+    TextBuffer line = { NULL, 0, 0 };
+    while (readLine(list, &line)) {
+        if (line.length > 0 && line.data[line.length - 1] == '\r') line.data[--line.length] = '\0';
+        if (line.length > 0) addCheckPath(paths, line.data);
+    }
+    memFree(line.data);
+    fclose(list);
+    return 1;
+}
 
-    char token[256];
-    char line[1024] = {0};
-    int inLoop = 0;
-    char loopBody[4096] = {0};
-
-    while (fgets(token, sizeof(token), file)) {
-        removeComments(token);
-        strtok(token, "\n");
-        if (strlen(token) == 0) continue;
-
-        if (strncmp(token, "Keyword(loop)", 13) == 0) {
-            inLoop = 1;
-            strcat(line, token);
-        } else if (inLoop) {
-            strcat(loopBody, " ");
-            strcat(loopBody, token);
-            if (strstr(token, "RightCurlyBracket") != NULL) {
-                inLoop = 0;
-                strcat(line, " ");
-                strcat(line, loopBody);
-                execute(line);
-                line[0] = '\0';
-                loopBody[0] = '\0';
-            }
-        } else {
-            if (strcmp(token, "EndOfLine") == 0) {
-                if (strlen(line) > 0) {
-                    execute(line);
-                    line[0] = '\0';
+typedef struct {
+    int checked;
+    long long tokens;
+    long long statements;
+    DiagnosticList list;
+} CheckResult;
+
+void writeJsonString(FILE* out, const char* text) {
+    fputc('"', out);
+    for (const unsigned char* p = (const unsigned char*)text; *p; p++) {
+        if (*p == '"' || *p == '\\') fprintf(out, "\\%c", *p);
+        else if (*p < 0x20) fprintf(out, "\\u%04x", *p);
+        else fputc(*p, out);
+    }
+    fputc('"', out);
+}
+
+int writeCheckSummary(const char* path, const PathList* paths, const CheckResult* results, int jobs, double seconds) {
+    FILE* out = fopen(path, "w");
+    if (out == NULL) {
+        printf("Error: Could not write %s.\n", path);
+        return 0;
+    }
+    int invalid = 0, diagnosticCount = 0;
+    long long tokens = 0, statements = 0;
+    for (int i = 0; i < paths->count; i++) {
+        invalid += results[i].list.count > 0;
+        diagnosticCount += results[i].list.count;
+        tokens += results[i].tokens;
+        statements += results[i].statements;
+    }
+    fprintf(out, "{\n  \"files\": %d,\n  \"valid\": %d,\n  \"invalid\": %d,\n  \"diagnostics\": %d,\n"
+                 "  \"tokens\": %lld,\n  \"statements\": %lld,\n  \"jobs\": %d,\n  \"seconds\": %.3f,\n  \"results\": [",
+            paths->count, paths->count - invalid, invalid, diagnosticCount, tokens, statements, jobs, seconds);
+    for (int i = 0; i < paths->count; i++) {
+        const CheckResult* result = &results[i];
+        fprintf(out, "%s\n    {\"file\": ", i > 0 ? "," : "");
+        writeJsonString(out, paths->items[i]);
+        fprintf(out, ", \"valid\": %s, \"tokens\": %lld, \"statements\": %lld, \"diagnostics\": [",
+                result->list.count == 0 ? "true" : "false", result->tokens, result->statements);
+        for (int k = 0; k < result->list.count; k++) {
+            fprintf(out, "%s{\"line\": %d, \"column\": %d, \"message\": ", k > 0 ? ", " : "",
+                    result->list.items[k].line, result->list.items[k].column);
+            writeJsonString(out, result->list.items[k].message);
+            fputc('}', out);
+        }
+        fprintf(out, "]}");
+    }
+    fprintf(out, "\n  ]\n}\n");
+    int ok = ferror(out) == 0;
+    if (fclose(out) != 0) ok = 0;
+    if (!ok) printf("Error: Could not write %s.\n", path);
+    return ok;
+}
+
+/* Checks every file with up to jobs worker processes; returns 1 when any file has a problem */
+int runCheck(const PathList* paths, int jobs, const char* summaryPath) {
+    long long start = profileNow();
+    if (jobs > paths->count) jobs = paths->count;
+    if (jobs < 1) jobs = 1;
+
+    FILE** records = (FILE**)memAlloc(MEM_TEMP, jobs * sizeof(FILE*));
+    for (int w = 0; w < jobs; w++) {
+        records[w] = tmpfile();
+        if (records[w] == NULL) {
+            printf("Error: Could not create a temporary file.\n");
+            return -1;
+        }
+    }
+
+    // Workers take files from a shared counter; the parent finishes whatever none of them took
+#if PARALLEL_CHECK_SUPPORTED
+    _Atomic int* next = (_Atomic int*)mmap(NULL, sizeof(_Atomic int), PROT_READ | PROT_WRITE,
+                                           MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (next == MAP_FAILED) {
+        printf("Error: Could not share the file counter.\n");
+        return -1;
+    }
+    atomic_init(next, 0);
+    if (jobs > 1) {
+        pid_t* workers = (pid_t*)memAlloc(MEM_TEMP, jobs * sizeof(pid_t));
+        int started = 0;
+        fflush(stdout);
+        for (int w = 0; w < jobs; w++) {
+            pid_t pid = fork();
+            if (pid < 0) break;
+            if (pid == 0) {
+                int index;
+                while ((index = atomic_fetch_add(next, 1)) < paths->count) {
+                    checkFile(paths->items[index], index, records[w]);
                 }
-            } else {
-                if (strlen(line) > 0) strcat(line, " ");
-                strcat(line, token);
+                fflush(records[w]);
+                _exit(0);
             }
+            workers[started++] = pid;
         }
+        for (int w = 0; w < started; w++) waitpid(workers[w], NULL, 0);
+        memFree(workers);
     }
+    int index;
+    while ((index = atomic_fetch_add(next, 1)) < paths->count) {
+        checkFile(paths->items[index], index, records[0]);
+    }
+    munmap((void*)next, sizeof(_Atomic int));
+#else
+    jobs = 1;
+    for (int index = 0; index < paths->count; index++) {
+        checkFile(paths->items[index], index, records[0]);
+    }
+#endif
+    fflush(records[0]);
 
-    if (strlen(line) > 0) {
-        execute(line);
+    // Collect the records by file
+    CheckResult* results = (CheckResult*)memCalloc(MEM_TEMP, paths->count, sizeof(CheckResult));
+    TextBuffer line = { NULL, 0, 0 };
+    for (int w = 0; w < jobs; w++) {
+        fseek(records[w], 0, SEEK_SET);
+        while (readLine(records[w], &line)) {
+            int fileIndex = -1, diagnosticLine = 0, diagnosticColumn = 0, messageStart = 0;
+            long long tokens = 0, statements = 0;
+            if (sscanf(line.data, "D\t%d\t%d\t%d\t%n", &fileIndex, &diagnosticLine, &diagnosticColumn, &messageStart) == 3 &&
+                messageStart > 0 && fileIndex >= 0 && fileIndex < paths->count) {
+                diagnostics = &results[fileIndex].list;
+                addDiagnostic(diagnosticLine, diagnosticColumn, "%s", line.data + messageStart);
+            } else if (sscanf(line.data, "F\t%d\t%lld\t%lld", &fileIndex, &tokens, &statements) == 3 &&
+                       fileIndex >= 0 && fileIndex < paths->count) {
+                results[fileIndex].checked = 1;
+                results[fileIndex].tokens = tokens;
+                results[fileIndex].statements = statements;
+            }
+        }
+        fclose(records[w]);
     }
+    diagnostics = NULL;
+    memFree(line.data);
+    memFree(records);
+    double seconds = (profileNow() - start) / 1e9;
 
-    fclose(file);
-    return 0;
+    int invalid = 0, diagnosticCount = 0;
+    long long tokens = 0, statements = 0;
+    for (int i = 0; i < paths->count; i++) {
+        if (!results[i].checked) {
+            // A worker stopped before finishing this file
+            diagnostics = &results[i].list;
+            addDiagnostic(0, 0, "Not checked: the worker stopped");
+            diagnostics = NULL;
+        }
+        for (int k = 0; k < results[i].list.count; k++) {
+            const Diagnostic* item = &results[i].list.items[k];
+            printf("%s:%d:%d: error: %s\n", paths->items[i], item->line, item->column, item->message);
+        }
+        invalid += results[i].list.count > 0;
+        diagnosticCount += results[i].list.count;
+        tokens += results[i].tokens;
+        statements += results[i].statements;
+    }
+    printf("Checked %d files (%lld tokens, %lld statements) in %.3f s with %d job%s: %d valid, %d with errors, %d diagnostics.\n",
+           paths->count, tokens, statements, seconds, jobs, jobs == 1 ? "" : "s", paths->count - invalid, invalid, diagnosticCount);
+
+    int status = invalid > 0 ? 1 : 0;
+    if (summaryPath != NULL && !writeCheckSummary(summaryPath, paths, results, jobs, seconds)) status = -1;
+
+    for (int i = 0; i < paths->count; i++) {
+        for (int k = 0; k < results[i].list.count; k++) memFree(results[i].list.items[k].message);
+        memFree(results[i].list.items);
+    }
+    memFree(results);
+    return status;
 }
 
+int main(int argc, char* argv[]) {
+    const char* resumePath = NULL;  // --resume: snapshot to continue from
+    const char* serverPath = NULL;  // --serve, --client, --bench: socket path
+    const char* script = "code.sta";
+    int serverMode = 0;             // 1: serve, 2: client, 3: bench
+    const char* inputPath = NULL;   // --input: data fed to the scheduled scripts
+    int workers = 4, requests = 1000, concurrency = 4;
+    int harnessScripts = 0;         // --harness: scripts run by the scheduler
+    int checkMode = 0;              // --check: validate the files, run nothing
+    int jobs = 0;                   // --jobs: check workers, 0 for one per processor
+    const char* summaryPath = NULL; // --summary: machine-readable check results
+    PathList checkPaths = { NULL, 0, 0 };
+
+    /* Command line options */
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-q") == 0 || strcmp(argv[i], "--quiet") == 0) {
+            quietMode = 1;
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            jitEnabled = 1;
+            if (!JIT_SUPPORTED) printf("Warning: --jit needs x86-64 Linux, running interpreted.\n");
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            profileEnabled = 1;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            statsEnabled = 1;
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            checkpointEnabled = 1;
+            checkpointPath = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-every") == 0 && i + 1 < argc) {
+            checkpointEvery = atoll(argv[++i]);
+            if (checkpointEvery <= 0) {
+                printf("Error: --checkpoint-every takes a positive statement count.\n");
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc) {
+            resumePath = argv[++i];
+        } else if ((strcmp(argv[i], "--serve") == 0 || strcmp(argv[i], "--client") == 0 ||
+                    strcmp(argv[i], "--bench") == 0) && i + 1 < argc) {
+            serverMode = argv[i][2] == 's' ? 1 : argv[i][2] == 'c' ? 2 : 3;
+            serverPath = argv[++i];
+        } else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc) {
+            script = argv[++i];
+        } else if (strcmp(argv[i], "--check") == 0) {
+            checkMode = 1;
+        } else if (strcmp(argv[i], "--summary") == 0 && i + 1 < argc) {
+            summaryPath = argv[++i];
+        } else if (checkMode && argv[i][0] != '-') {
+            if (!addCheckArgument(&checkPaths, argv[i])) return -1;
+        } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            inputPath = argv[++i];
+        } else if ((strcmp(argv[i], "--workers") == 0 || strcmp(argv[i], "--requests") == 0 ||
+                    strcmp(argv[i], "--concurrency") == 0 || strcmp(argv[i], "--harness") == 0 ||
+                    strcmp(argv[i], "--jobs") == 0) && i + 1 < argc) {
+            int value = atoi(argv[i + 1]);
+            if (value <= 0) {
+                printf("Error: %s takes a positive number.\n", argv[i]);
+                return -1;
+            }
+            if (argv[i][2] == 'w') workers = value;
+            else if (argv[i][2] == 'r') requests = value;
+            else if (argv[i][2] == 'h') harnessScripts = value;
+            else if (argv[i][2] == 'j') jobs = value;
+            else concurrency = value;
+            i++;
+        } else if ((strcmp(argv[i], "--max-statements") == 0 || strcmp(argv[i], "--max-text") == 0 ||
+                    strcmp(argv[i], "--max-time") == 0) && i + 1 < argc) {
+            double value = atof(argv[i + 1]);
+            if (value <= 0) {
+                printf("Error: %s takes a positive number.\n", argv[i]);
+                return -1;
+            }
+            if (strcmp(argv[i], "--max-statements") == 0) statementLimit = (long long)value;
+            else if (strcmp(argv[i], "--max-text") == 0) textLimit = (long long)value;
+            else timeLimit = (long long)(value * 1e9);
+            limitsEnabled = 1;
+            i++;
+        } else if (strcmp(argv[i], "--no-fold") == 0) {
+            foldEnabled = 0;
+        } else if (strcmp(argv[i], "--pipeline") == 0) {
+            pipelineEnabled = 1;
+            if (!PIPELINE_SUPPORTED) printf("Warning: --pipeline needs POSIX threads, lexing first.\n");
+        } else if (strcmp(argv[i], "--prompt") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "always") == 0) promptMode = PROMPT_ALWAYS;
+            else if (strcmp(argv[i], "auto") == 0) promptMode = PROMPT_AUTO;
+            else if (strcmp(argv[i], "never") == 0) promptMode = PROMPT_NEVER;
+            else {
+                printf("Error: --prompt takes always, auto or never.\n");
+                return -1;
+            }
+        } else {
+            printf("Usage: %s [-q|--quiet] [--jit] [--profile] [--stats] [--pipeline] [--no-fold] [--prompt always|auto|never]"
+                   " [--checkpoint FILE [--checkpoint-every N]] [--resume FILE]"
+                   " [--max-statements N] [--max-text BYTES] [--max-time SECONDS]"
+                   " [--serve SOCKET [--workers N] | --client SOCKET [--script FILE]"
+                   " | --bench SOCKET [--script FILE] [--requests N] [--concurrency N]"
+                   " | --harness N [--script FILE] [--input FILE]"
+                   " | --check [--jobs N] [--summary FILE] FILE|@LIST...]\n", argv[0]);
+            return -1;
+        }
+    }
+    if (promptMode == PROMPT_AUTO) {
+        promptMode = isatty(fileno(stdin)) ? PROMPT_ALWAYS : PROMPT_NEVER;
+    }
+    if (profileEnabled && jitEnabled) {
+        printf("Warning: --profile times every statement, --jit is ignored.\n");
+        jitEnabled = 0;
+    }
+    if (serverMode != 0) {
+#if SERVER_SUPPORTED
+        if (serverMode == 1) return runServer(serverPath, workers);
+        if (serverMode == 2) return runClient(serverPath, script);
+        return runBench(serverPath, script, requests, concurrency);
+#else
+        printf("Error: --serve, --client and --bench need Unix domain sockets.\n");
+        return -1;
+#endif
+    }
+    if (checkMode) {
+        if (checkPaths.count == 0) {
+            printf("Error: --check needs at least one file.\n");
+            return -1;
+        }
+#if PARALLEL_CHECK_SUPPORTED
+        if (jobs == 0) jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+        int status = runCheck(&checkPaths, jobs, summaryPath);
+        if (statsEnabled) printStats();
+        return status;
+    }
+    if (harnessScripts > 0) {
+#if SCHEDULER_SUPPORTED
+        if (jitEnabled || profileEnabled || checkpointEnabled || resumePath != NULL) {
+            printf("Warning: --harness runs scripts interpreted, without profile or checkpoints.\n");
+            jitEnabled = profileEnabled = checkpointEnabled = 0;
+        }
+        int status = runHarness(script, inputPath, harnessScripts);
+        if (statsEnabled) printStats();
+        return status;
+#else
+        printf("Error: --harness needs POSIX pipes and ucontext.\n");
+        return -1;
+#endif
+    }
+    if (checkpointEvery > 0 && !checkpointEnabled) {
+        printf("Error: --checkpoint-every needs --checkpoint FILE.\n");
+        return -1;
+    }
+    if (checkpointEnabled && jitEnabled) {
+        printf("Warning: --checkpoint stops between statements, --jit is ignored.\n");
+        jitEnabled = 0;
+    }
+    if (checkpointEnabled || resumePath != NULL) {
+        scriptHash = hashFile("code.sta");
+    }
+    if (resumePath != NULL && !readCheckpoint(resumePath)) {
+        return -1;
+    }
+    nextCheckpointAt = statementCount + checkpointEvery;
+    startLimits();
+#ifdef SIGUSR1
+    if (checkpointEnabled) signal(SIGUSR1, requestCheckpoint);
+#endif
 
-int main() {
     /* Open input and output files */
     FILE *inputFile = fopen("code.sta", "r");    // Open input file
     FILE *outputFile = fopen("code.lex", "w");   // Open output file
@@ -885,31 +4557,28 @@ int main() {
         return -1;                            // Exit with error code
     }
 
-    /* Read tokens and write to output file */
-    Token token;
-    int endOfLineCount = 0;   // End of line counter
-    do {
-        token = getNextToken(inputFile);   // Get the next token
-        if (token.type != END_OF_LINE) {   // If the token is not an end of line
-            if (endOfLineCount > 0) {      // If the previous token was an end of line
-                printToken((Token){END_OF_LINE, ""});   // Write the end of line token
-            }
-            printToken(token);              // Write the token
-            endOfLineCount = 0;            // Reset the end of line counter
-        } else {
-            endOfLineCount++;              // If the token is an end of line, increment the counter
-        }
-    } while (!feof(inputFile));            // Continue until the end of the file
+#if PIPELINE_SUPPORTED
+    if (pipelineEnabled) {
+        runPipeline(inputFile, outputFile);
+    } else
+#endif
+    {
+        /* Read tokens and write to output file */
+        lexTokens(inputFile, emitToFile, outputFile);
 
-    if (endOfLineCount > 0) {              // If there is an end of line at the end of the file
-        printToken((Token){END_OF_LINE, ""});   // Write the end of line token
-    }
+        /* Close files */
+        fclose(inputFile);                 // Close the input file
+        fclose(outputFile);                // Close the output file
 
-    /* Close files */
-    fclose(inputFile);                     // Close the input file
-    fclose(outputFile);                    // Close the output file
+        Interpreter();
+    }
 
-    Interpreter();
+    if (profileEnabled) {
+        profileReport();
+    }
+    if (statsEnabled) {
+        printStats();
+    }
 
     return 0;                              // Exit successfully
 }
\ No newline at end of file
@@ -0,0 +1,176 @@
+#!/bin/sh
+# Adversarial inputs for the lexer and the statement loader.
+#
+# Every generator takes a size; the timed cases run at two sizes and fail when doubling the
+# input more than triples the wall time (a quadratic pass quadruples it) or when a run takes
+# longer than the time limit. Nesting is accepted at 64 levels and rejected at 65.
+#
+# Usage: tests/adversarial.sh [INTERPRETER]
+# Without an argument interpreter.c is compiled into a temporary directory.
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+SIZE=${SIZE:-20000}         # Smaller size of the timed cases
+TIME_LIMIT=${TIME_LIMIT:-10} # Seconds allowed for one run
+MAX_RATIO=3                 # Largest time ratio accepted when the input doubles
+
+if [ -n "$1" ]; then
+    INTERP=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+else
+    INTERP=$WORK/interp
+    gcc -O2 -pthread -o "$INTERP" "$ROOT/interpreter.c" || exit 1
+fi
+cd "$WORK" || exit 1
+
+failures=0
+
+fail() {
+    echo "FAIL: $*"
+    failures=$((failures + 1))
+}
+
+now() {
+    date +%s%N
+}
+
+# Runs code.sta quietly; sets status, output and elapsed (nanoseconds)
+run() {
+    start=$(now)
+    timeout "$TIME_LIMIT" "$INTERP" -q > out.txt 2>&1 < /dev/null
+    status=$?
+    elapsed=$(( $(now) - start ))
+    output=$(tail -c 300 out.txt)
+}
+
+# --- Generators: each writes code.sta for size $1 ---
+
+# /* nested 10 n deep */ followed by a statement
+gen_comments() {
+    awk -v n="$(($1 * 10))" 'BEGIN {
+        for (i = 0; i < n; i++) printf "/* ";
+        for (i = 0; i < n; i++) printf " */";
+        print " int a is 7. write a.";
+    }' > code.sta
+}
+
+# int a0 is 1, a1 is 1, ... in one statement; the run stops at the variable limit
+gen_declarations() {
+    awk -v n="$1" 'BEGIN {
+        printf "int a0 is 1";
+        for (i = 1; i < n; i++) printf ", a%d is 1", i;
+        print ".";
+    }' > code.sta
+}
+
+# One write of n / 4 string literals of 253 characters, the longest accepted
+gen_strings() {
+    awk -v n="$1" 'BEGIN {
+        s = ""; for (i = 0; i < 253; i++) s = s "x";
+        printf "write \"%s\"", s;
+        for (i = 1; i < n / 4; i++) printf ", \"%s\"", s;
+        print ".";
+    }' > code.sta
+}
+
+# A loop body of n statements
+gen_body() {
+    awk -v n="$1" 'BEGIN {
+        print "int a.";
+        print "loop 2 times {";
+        for (i = 0; i < n; i++) print "  a is a + 1.";
+        print "}";
+        print "write \"done\".";
+    }' > code.sta
+}
+
+# Loops nested $1 deep; $2 is braced or braceless
+gen_nested() {
+    awk -v n="$1" -v style="$2" 'BEGIN {
+        print "int a.";
+        for (i = 0; i < n; i++) printf (style == "braced" ? "loop 1 times { " : "loop 1 times ");
+        printf "a is a + 1.";
+        if (style == "braced") for (i = 0; i < n; i++) printf " }";
+        print "";
+        print "write a.";
+    }' > code.sta
+}
+
+# --- Scaling ---
+
+# Runs generator $1 at SIZE and twice SIZE; $2 is a pattern the output must match
+check_scaling() {
+    name=$1
+    pattern=$2
+    "gen_$name" "$SIZE"
+    run
+    small=$elapsed
+    case "$output" in *$pattern*) ;; *) fail "$name: unexpected output: $output" ;; esac
+    [ "$status" -eq 124 ] && fail "$name: over ${TIME_LIMIT}s at size $SIZE"
+
+    "gen_$name" $((SIZE * 2))
+    run
+    large=$elapsed
+    case "$output" in *$pattern*) ;; *) fail "$name: unexpected output: $output" ;; esac
+    [ "$status" -eq 124 ] && fail "$name: over ${TIME_LIMIT}s at size $((SIZE * 2))"
+
+    # Runs under 50 ms are mostly process start; compare them as 50 ms
+    base=$small
+    [ "$base" -lt 50000000 ] && base=50000000
+    if [ "$large" -gt $((base * MAX_RATIO)) ]; then
+        fail "$name: $((small / 1000000)) ms at size $SIZE, $((large / 1000000)) ms at size $((SIZE * 2))"
+    else
+        echo "ok   $name: $((small / 1000000)) ms, $((large / 1000000)) ms at twice the size"
+    fi
+}
+
+check_scaling comments "7"
+check_scaling declarations "Too many variables declared"
+check_scaling strings "xxxxxxxxxx"
+check_scaling body "done"
+
+# --- Limits ---
+
+# String literals: 253 characters are accepted, 254 are not
+before=$failures
+awk 'BEGIN { s = ""; for (i = 0; i < 253; i++) s = s "y"; print "write \"" s "\"." }' > code.sta
+run
+[ "$status" -eq 0 ] || fail "253 character string rejected: $output"
+awk 'BEGIN { s = ""; for (i = 0; i < 254; i++) s = s "y"; print "write \"" s "\"." }' > code.sta
+run
+case "$output" in *"String constant too long"*) ;; *) fail "254 character string accepted: $output" ;; esac
+[ "$failures" -eq "$before" ] && echo "ok   string literal length"
+
+# A folded text longer than a literal must be left unfolded; the expression still evaluates
+before=$failures
+awk 'BEGIN {
+    a = ""; for (i = 0; i < 126; i++) a = a "A";
+    c = ""; for (i = 0; i < 127; i++) c = c "C";
+    print "text a. a is \"" a " B\" + \"" c "\". write a.";
+}' > code.sta
+run
+[ "$status" -eq 0 ] || fail "folded long text exited with $status: $output"
+folded=$(cat out.txt)
+timeout "$TIME_LIMIT" "$INTERP" -q --no-fold > out.txt 2>&1 < /dev/null
+[ "$folded" = "$(cat out.txt)" ] || fail "folded long text differs from --no-fold: $output"
+[ "$failures" -eq "$before" ] && echo "ok   folded text length"
+
+for style in braced braceless; do
+    before=$failures
+    gen_nested 64 "$style"
+    run
+    case "$output" in *"Loops nested"*) fail "$style nesting of 64 rejected: $output" ;; esac
+    [ "$status" -eq 0 ] || fail "$style nesting of 64 exited with $status: $output"
+
+    gen_nested 65 "$style"
+    run
+    case "$output" in *"Loops nested deeper than 64"*) ;; *) fail "$style nesting of 65 accepted: $output" ;; esac
+    [ "$failures" -eq "$before" ] && echo "ok   $style nesting"
+done
+
+if [ "$failures" -gt 0 ]; then
+    echo "$failures failed"
+    exit 1
+fi
+echo "All adversarial checks passed"